@@ -0,0 +1,96 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "arena.h"
+
+// a block of arena memory, blocks past the first only live until the next reset
+typedef struct arena_block {
+    struct arena_block *next;
+    char *data;
+    int capacity;
+    int used;
+} arena_block_t;
+
+static arena_block_t *first_block = NULL;
+// overflow blocks of the current frame, newest first
+static arena_block_t *overflow_blocks = NULL;
+static int frame_used = 0;
+static int peak_used = 0;
+
+static arena_block_t *new_block(int capacity){
+    // room to move the data up to the next aligned address
+    arena_block_t *block = (arena_block_t*) malloc(sizeof(arena_block_t) + capacity + FRAME_ARENA_ALIGNMENT);
+    uintptr_t data = (uintptr_t)(block + 1);
+    data = (data + FRAME_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(FRAME_ARENA_ALIGNMENT - 1);
+    block->next = NULL;
+    block->data = (char*) data;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+void init_frame_arena(int initial_size){
+    first_block = new_block(initial_size);
+}
+
+static void *block_alloc(arena_block_t *block, int size){
+    if (block->used + size > block->capacity) return NULL;
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+void* frame_alloc(int size){
+    size = (size + FRAME_ARENA_ALIGNMENT - 1) & ~(FRAME_ARENA_ALIGNMENT - 1);
+    frame_used += size;
+    if (frame_used > peak_used) peak_used = frame_used;
+
+    void *memory = block_alloc(overflow_blocks != NULL ? overflow_blocks : first_block, size);
+    if (memory != NULL) return memory;
+
+    // out of room, chain a block at least as large as everything allocated so far
+    int capacity = frame_used > size ? frame_used : size;
+    arena_block_t *block = new_block(capacity);
+    block->next = overflow_blocks;
+    overflow_blocks = block;
+    return block_alloc(block, size);
+}
+
+void reset_frame_arena(void){
+    // a frame that overflowed replaces all blocks with one that fits its peak,
+    // so later frames allocate without touching the heap again
+    if (overflow_blocks != NULL){
+        while (overflow_blocks != NULL){
+            arena_block_t *next = overflow_blocks->next;
+            free(overflow_blocks);
+            overflow_blocks = next;
+        }
+        free(first_block);
+        first_block = new_block(peak_used);
+    }
+    first_block->used = 0;
+    frame_used = 0;
+}
+
+int getFrameArenaUsed(void){
+    return frame_used;
+}
+
+int getFrameArenaPeak(void){
+    return peak_used;
+}
+
+int getFrameArenaCapacity(void){
+    int capacity = first_block != NULL ? first_block->capacity : 0;
+    for (arena_block_t *block = overflow_blocks; block != NULL; block = block->next){
+        capacity += block->capacity;
+    }
+    return capacity;
+}
+
+void free_frame_arena(void){
+    if (first_block == NULL) return;
+    reset_frame_arena();
+    free(first_block);
+    first_block = NULL;
+    peak_used = 0;
+}
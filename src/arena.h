@@ -0,0 +1,21 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// size of the first block, the arena grows to the peak use of a frame from there
+#define FRAME_ARENA_INITIAL_SIZE (4 << 20)
+// every allocation starts on a cache line
+#define FRAME_ARENA_ALIGNMENT 64
+
+void init_frame_arena(int initial_size);
+
+// memory valid until the next reset, only to be called from the main thread
+void* frame_alloc(int size);
+void reset_frame_arena(void);
+
+int getFrameArenaUsed(void);
+int getFrameArenaPeak(void);
+int getFrameArenaCapacity(void);
+
+void free_frame_arena(void);
+
+#endif //ARENA_H
@@ -33,6 +33,20 @@ int array_size(void* array) {
     return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
 }
 
+void array_clear(void* array) {
+    // keep the capacity so the array can be refilled without reallocating
+    if (array != NULL) {
+        ARRAY_OCCUPIED(array) = 0;
+    }
+}
+
+void array_truncate(void* array, int count) {
+    // drop the items past count, keeping the capacity
+    if (array != NULL && count < ARRAY_OCCUPIED(array)) {
+        ARRAY_OCCUPIED(array) = count;
+    }
+}
+
 void array_free(void* array) {
     if (array != NULL) {
         free(ARRAY_RAW_DATA(array));
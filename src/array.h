@@ -9,6 +9,8 @@
 
 void* array_hold(void* array, int count, int item_size);
 int array_size(void* array);
+void array_clear(void* array);
+void array_truncate(void* array, int count);
 void array_free(void* array);
 
 #endif //ARRAY_H
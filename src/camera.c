@@ -9,6 +9,7 @@ void init_camera(vec3_t position, vec3_t direction){
     camera.forward_velocity = vec3_new(0.0, 0.0, 0.0);
     camera.yaw_angle = 0.0;
     camera.pitch_angle = 0.0;
+    camera.version++;
 }
 
 vec3_t getCameraPosition(void){
@@ -31,12 +32,18 @@ float getCameraPitchAngle(void){
     return camera.pitch_angle;
 }
 
+int getCameraVersion(void){
+    return camera.version;
+}
+
 void setCameraPosition(vec3_t position){
     camera.position = position;
+    camera.version++;
 }
 
 void setCameraDirection(vec3_t direction){
     camera.direction = direction;
+    camera.version++;
 }
 
 void setCameraForwardVelocity(vec3_t forward_velocity){
@@ -45,10 +52,12 @@ void setCameraForwardVelocity(vec3_t forward_velocity){
 
 void setCameraYawAngle(float yaw_angle){
     camera.yaw_angle += yaw_angle;
+    camera.version++;
 }
 
 void setCameraPitchAngle(float pitch_angle){
     camera.pitch_angle += pitch_angle;
+    camera.version++;
 }
 
 void moveCamera(char dir, float distance){
@@ -61,6 +70,7 @@ void moveCamera(char dir, float distance){
     else if (dir == 'z'){
         camera.position.z += distance;
     }
+    camera.version++;
 }
 
 vec3_t getLookAtTarget(void){
@@ -9,6 +9,8 @@ typedef struct{
     vec3_t forward_velocity;
     float yaw_angle;
     float pitch_angle;
+    // bumped on every change so cached view dependent data can be refreshed
+    int version;
 } camera_t;
 
 void init_camera(vec3_t position, vec3_t direction);
@@ -18,6 +20,7 @@ vec3_t getCameraDirection(void);
 vec3_t getCameraForwardVelocity(void);
 float getCameraYawAngle(void);
 float getCameraPitchAngle(void);
+int getCameraVersion(void);
 
 void setCameraPosition(vec3_t position);
 void setCameraDirection(vec3_t direction);
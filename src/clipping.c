@@ -1,9 +1,34 @@
 #include "clipping.h"
+#include "frame.h"
 #include <math.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define NUM_PLANES 6
+#define NUM_SIDE_PLANES 4
 plane_t frustum_planes[NUM_PLANES];
 
+// clip space planes as coefficients of (x, y, z, w), a vertex is inside when the dot product is not negative,
+// depth runs from 0 to w as set up by mat4_perspective
+static const vec4_t clip_planes[NUM_PLANES] = {
+    { 1, 0, 0, 1 },
+    { -1, 0, 0, 1 },
+    { 0, -1, 0, 1 },
+    { 0, 1, 0, 1 },
+    { 0, 0, 1, 0 },
+    { 0, 0, -1, 1 }
+};
+
+static const vec4_t guard_band_planes[NUM_SIDE_PLANES] = {
+    { 1, 0, 0, GUARD_BAND_SCALE },
+    { -1, 0, 0, GUARD_BAND_SCALE },
+    { 0, -1, 0, GUARD_BAND_SCALE },
+    { 0, 1, 0, GUARD_BAND_SCALE }
+};
+
 void initialize_frustum_plane(float fov_x, float fov_y, float z_near, float z_far){
     float sin_half_fov_x = sin(fov_x / 2);
     float cos_half_fov_x = cos(fov_x / 2);
@@ -29,46 +54,173 @@ void initialize_frustum_plane(float fov_x, float fov_y, float z_near, float z_fa
     frustum_planes[FAR_FRUSTUM_PLANE].normal = vec3_new(0, 0, -1);
 }
 
-polygon_t create_polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2){
-    polygon_t polygon = {
-        .vertices = {v0, v1, v2},
-        .texcoords = {t0, t1, t2},
-        .num_vertices = 3
-    };
-    return polygon;
+vec4_t getClipPlane(int plane){
+    return clip_planes[plane];
 }
 
-float float_lerp(float a, float b, float t){
-    return a + (b - a) * t;
+int classify_sphere(vec3_t center, float radius){
+    // sphere in view space against the view space frustum planes
+    int result = FRUSTUM_INSIDE;
+    for (int plane = 0; plane < NUM_PLANES; plane++){
+        float distance = vec3_dot(vec3_sub(center, frustum_planes[plane].point), frustum_planes[plane].normal);
+        if (distance < -radius) return FRUSTUM_OUTSIDE;
+        if (distance < radius) result = FRUSTUM_INTERSECT;
+    }
+    return result;
+}
+
+int compute_clip_outcode(vec4_t vertex){
+    int code = 0;
+    for (int plane = 0; plane < NUM_PLANES; plane++){
+        if (vec4_dot(vertex, clip_planes[plane]) < 0) code |= 1 << plane;
+    }
+    for (int plane = 0; plane < NUM_SIDE_PLANES; plane++){
+        if (vec4_dot(vertex, guard_band_planes[plane]) < 0) code |= GUARD_BAND_OUTCODE << plane;
+    }
+    return code;
+}
+
+void add_to_clip_batch(clip_batch_t *batch, vec4_t vertices[3], tex2_t texcoords[3], uint32_t color){
+    int i = batch->num_triangles++;
+    for (int j = 0; j < 3; j++){
+        batch->x[j][i] = vertices[j].x;
+        batch->y[j][i] = vertices[j].y;
+        batch->z[j][i] = vertices[j].z;
+        batch->w[j][i] = vertices[j].w;
+        batch->u[j][i] = texcoords[j].u;
+        batch->v[j][i] = texcoords[j].v;
+    }
+    batch->color[i] = color;
+}
+
+#if defined(__AVX2__)
+
+#define OUTCODE_BIT(distance, bit) \
+    _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps((distance), zero, _CMP_LT_OQ)), _mm256_set1_epi32(bit))
+
+// outcodes of 8 triangles at once, combined over their three vertices
+static void compute_batch_outcodes(clip_batch_t *batch, int *and_codes, int *or_codes){
+    __m256 zero = _mm256_setzero_ps();
+    __m256 guard_band_scale = _mm256_set1_ps(GUARD_BAND_SCALE);
+
+    for (int i = 0; i < batch->num_triangles; i += 8){
+        __m256i and_code = _mm256_set1_epi32(-1);
+        __m256i or_code = _mm256_setzero_si256();
+
+        for (int j = 0; j < 3; j++){
+            __m256 x = _mm256_loadu_ps(&batch->x[j][i]);
+            __m256 y = _mm256_loadu_ps(&batch->y[j][i]);
+            __m256 z = _mm256_loadu_ps(&batch->z[j][i]);
+            __m256 w = _mm256_loadu_ps(&batch->w[j][i]);
+            __m256 guard_w = _mm256_mul_ps(w, guard_band_scale);
+
+            __m256i code = OUTCODE_BIT(_mm256_add_ps(w, x), 1 << LEFT_FRUSTUM_PLANE);
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_sub_ps(w, x), 1 << RIGHT_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_sub_ps(w, y), 1 << TOP_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_add_ps(w, y), 1 << BOTTOM_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(z, 1 << NEAR_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_sub_ps(w, z), 1 << FAR_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_add_ps(guard_w, x), GUARD_BAND_OUTCODE << LEFT_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_sub_ps(guard_w, x), GUARD_BAND_OUTCODE << RIGHT_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_sub_ps(guard_w, y), GUARD_BAND_OUTCODE << TOP_FRUSTUM_PLANE));
+            code = _mm256_or_si256(code, OUTCODE_BIT(_mm256_add_ps(guard_w, y), GUARD_BAND_OUTCODE << BOTTOM_FRUSTUM_PLANE));
+
+            and_code = _mm256_and_si256(and_code, code);
+            or_code = _mm256_or_si256(or_code, code);
+        }
+
+        _mm256_storeu_si256((__m256i*) &and_codes[i], and_code);
+        _mm256_storeu_si256((__m256i*) &or_codes[i], or_code);
+    }
+}
+
+#elif defined(__SSE2__)
+
+#define OUTCODE_BIT(distance, bit) \
+    _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps((distance), zero)), _mm_set1_epi32(bit))
+
+// outcodes of 4 triangles at once, combined over their three vertices
+static void compute_batch_outcodes(clip_batch_t *batch, int *and_codes, int *or_codes){
+    __m128 zero = _mm_setzero_ps();
+    __m128 guard_band_scale = _mm_set1_ps(GUARD_BAND_SCALE);
+
+    for (int i = 0; i < batch->num_triangles; i += 4){
+        __m128i and_code = _mm_set1_epi32(-1);
+        __m128i or_code = _mm_setzero_si128();
+
+        for (int j = 0; j < 3; j++){
+            __m128 x = _mm_loadu_ps(&batch->x[j][i]);
+            __m128 y = _mm_loadu_ps(&batch->y[j][i]);
+            __m128 z = _mm_loadu_ps(&batch->z[j][i]);
+            __m128 w = _mm_loadu_ps(&batch->w[j][i]);
+            __m128 guard_w = _mm_mul_ps(w, guard_band_scale);
+
+            __m128i code = OUTCODE_BIT(_mm_add_ps(w, x), 1 << LEFT_FRUSTUM_PLANE);
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_sub_ps(w, x), 1 << RIGHT_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_sub_ps(w, y), 1 << TOP_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_add_ps(w, y), 1 << BOTTOM_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(z, 1 << NEAR_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_sub_ps(w, z), 1 << FAR_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_add_ps(guard_w, x), GUARD_BAND_OUTCODE << LEFT_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_sub_ps(guard_w, x), GUARD_BAND_OUTCODE << RIGHT_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_sub_ps(guard_w, y), GUARD_BAND_OUTCODE << TOP_FRUSTUM_PLANE));
+            code = _mm_or_si128(code, OUTCODE_BIT(_mm_add_ps(guard_w, y), GUARD_BAND_OUTCODE << BOTTOM_FRUSTUM_PLANE));
+
+            and_code = _mm_and_si128(and_code, code);
+            or_code = _mm_or_si128(or_code, code);
+        }
+
+        _mm_storeu_si128((__m128i*) &and_codes[i], and_code);
+        _mm_storeu_si128((__m128i*) &or_codes[i], or_code);
+    }
 }
 
-void clip_poly_against_plane(polygon_t *polygon, int plane){
-    vec3_t plane_point = frustum_planes[plane].point;
-    vec3_t plane_normal = frustum_planes[plane].normal;
+#else
 
-    vec3_t inside_vertices[MAX_POLY_VERTICES];
+static void compute_batch_outcodes(clip_batch_t *batch, int *and_codes, int *or_codes){
+    for (int i = 0; i < batch->num_triangles; i++){
+        and_codes[i] = -1;
+        or_codes[i] = 0;
+
+        for (int j = 0; j < 3; j++){
+            vec4_t vertex = { batch->x[j][i], batch->y[j][i], batch->z[j][i], batch->w[j][i] };
+            int code = compute_clip_outcode(vertex);
+
+            and_codes[i] &= code;
+            or_codes[i] |= code;
+        }
+    }
+}
+
+#endif
+
+static float float_lerp(float a, float b, float t){
+    return a + (b - a) * t;
+}
+
+static void clip_poly_against_plane(polygon_t *polygon, vec4_t plane){
+    vec4_t inside_vertices[MAX_POLY_VERTICES];
     tex2_t inside_texcoords[MAX_POLY_VERTICES];
     int num_inside_vertices = 0;
 
-    vec3_t *current_vertex = &polygon->vertices[0];
-    tex2_t *current_texcoord = &polygon->texcoords[0];
-    vec3_t *previous_vertex = &polygon->vertices[polygon->num_vertices - 1];
+    vec4_t *previous_vertex = &polygon->vertices[polygon->num_vertices - 1];
     tex2_t *previous_texcoord = &polygon->texcoords[polygon->num_vertices - 1];
+    float previous_dot = vec4_dot(*previous_vertex, plane);
 
-    float current_dot = 0;
-    float previous_dot = vec3_dot(vec3_sub(*previous_vertex, plane_point), plane_normal);
-
-    while (current_vertex != &polygon->vertices[polygon->num_vertices]){
-        current_dot = vec3_dot(vec3_sub(*current_vertex, plane_point), plane_normal);
+    for (int i = 0; i < polygon->num_vertices; i++){
+        vec4_t *current_vertex = &polygon->vertices[i];
+        tex2_t *current_texcoord = &polygon->texcoords[i];
+        float current_dot = vec4_dot(*current_vertex, plane);
 
         if (current_dot * previous_dot < 0){
-            // find the interpolation factor and calculate the point
+            // find the interpolation factor, clip space is linear so attributes interpolate directly
             float t = previous_dot / (previous_dot - current_dot);
 
-            vec3_t intersection_point = {
+            vec4_t intersection_point = {
                 .x = float_lerp(previous_vertex->x, current_vertex->x, t),
                 .y = float_lerp(previous_vertex->y, current_vertex->y, t),
-                .z = float_lerp(previous_vertex->z, current_vertex->z, t)
+                .z = float_lerp(previous_vertex->z, current_vertex->z, t),
+                .w = float_lerp(previous_vertex->w, current_vertex->w, t)
             };
 
             tex2_t intersection_texcoord = {
@@ -76,56 +228,143 @@ void clip_poly_against_plane(polygon_t *polygon, int plane){
                 .v = float_lerp(previous_texcoord->v, current_texcoord->v, t)
             };
 
-            inside_vertices[num_inside_vertices] = vec3_clone(&intersection_point);
-            inside_texcoords[num_inside_vertices] = tex2_clone(&intersection_texcoord);
+            inside_vertices[num_inside_vertices] = intersection_point;
+            inside_texcoords[num_inside_vertices] = intersection_texcoord;
             num_inside_vertices++;
         }
 
-        if (current_dot > 0){
-            inside_vertices[num_inside_vertices] = vec3_clone(current_vertex);
-            inside_texcoords[num_inside_vertices] = tex2_clone(current_texcoord);
+        if (current_dot >= 0){
+            inside_vertices[num_inside_vertices] = *current_vertex;
+            inside_texcoords[num_inside_vertices] = *current_texcoord;
             num_inside_vertices++;
         }
 
         previous_vertex = current_vertex;
         previous_texcoord = current_texcoord;
         previous_dot = current_dot;
-        current_vertex++;
-        current_texcoord++;
     }
 
     for (int i = 0; i < num_inside_vertices; i++){
-        polygon->vertices[i] = vec3_clone(&inside_vertices[i]);
-        polygon->texcoords[i] = tex2_clone(&inside_texcoords[i]);
+        polygon->vertices[i] = inside_vertices[i];
+        polygon->texcoords[i] = inside_texcoords[i];
     }
     polygon->num_vertices = num_inside_vertices;
 }
 
-void clip_polygon(polygon_t* polygon){
-    clip_poly_against_plane(polygon, LEFT_FRUSTUM_PLANE);
-    clip_poly_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
-    clip_poly_against_plane(polygon, TOP_FRUSTUM_PLANE);
-    clip_poly_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
-    clip_poly_against_plane(polygon, NEAR_FRUSTUM_PLANE);
-    clip_poly_against_plane(polygon, FAR_FRUSTUM_PLANE);
+// values past the 16 bit range are clamped, converting them to int16_t directly is undefined
+static int16_t saturate_int16(float value){
+    if (value <= INT16_MIN) return INT16_MIN;
+    if (value >= INT16_MAX) return INT16_MAX;
+    return (int16_t) value;
+}
+
+// texture coordinates of one triangle rounded to fixed point. sampling wraps, so when a corner falls outside
+// the fixed point range the triangle is moved by whole repeats to start at its smallest coordinate
+static void pack_texcoords(const float coords[3], int16_t output[3]){
+    float shift = 0;
+    for (int j = 0; j < 3; j++){
+        float value = coords[j] * TEXCOORD_SCALE;
+        if (value <= INT16_MIN || value >= INT16_MAX){
+            shift = floorf(fminf(coords[0], fminf(coords[1], coords[2])));
+            break;
+        }
+    }
+    for (int j = 0; j < 3; j++){
+        // only a triangle spanning eight repeats or more is still clamped
+        float value = (coords[j] - shift) * TEXCOORD_SCALE;
+        output[j] = saturate_int16(value < 0 ? value - 0.5f : value + 0.5f);
+    }
 }
 
-void break_polygon(polygon_t* polygon, triangle_t triangles[], int *num_triangles){
-    for (int i = 0; i < polygon->num_vertices - 2; i++) {
-        int index_0 = 0;
-        int index_1 = i + 1;
-        int index_2 = i + 2;
+static void emit_triangle(vec4_t vertices[3], tex2_t texcoords[3], uint32_t color, uint16_t material, render_packet_t *output){
+    mat4_t viewport = getFrameConstants()->viewport_matrix;
+    // texture coordinates with v flipped the same way the scanline rasterizer does
+    float u[3], v[3];
+
+    for (int j = 0; j < 3; j++){
+        vec4_t vertex = vertices[j];
 
-        triangles[i].points[0] = vec4_from_vec3(polygon->vertices[index_0]);
-        triangles[i].points[1] = vec4_from_vec3(polygon->vertices[index_1]);
-        triangles[i].points[2] = vec4_from_vec3(polygon->vertices[index_2]);
+        // perspective divide, 1/w interpolates linearly across the screen
+        vertex.x /= vertex.w;
+        vertex.y /= vertex.w;
+        float inv_w = 1.0 / vertex.w;
 
-        triangles[i].tex_coords[0] = polygon->texcoords[index_0];
-        triangles[i].tex_coords[1] = polygon->texcoords[index_1];
-        triangles[i].tex_coords[2] = polygon->texcoords[index_2];
+        // scale and translate point to the screen, snapped toward zero like the rasterizers always did
+        output->x[j] = saturate_int16(vertex.x * viewport.m[0][0] + viewport.m[0][3]);
+        output->y[j] = saturate_int16(vertex.y * viewport.m[1][1] + viewport.m[1][3]);
+        output->inv_w[j] = inv_w;
+        u[j] = texcoords[j].u;
+        v[j] = 1.0 - texcoords[j].v;
+    }
+    pack_texcoords(u, output->u);
+    pack_texcoords(v, output->v);
+    output->color = color;
+    output->material = material;
+}
+
+int clip_batch(clip_batch_t *batch, render_packet_t *output, int max_output){
+    int and_codes[CLIP_BATCH_SIZE];
+    int or_codes[CLIP_BATCH_SIZE];
+    compute_batch_outcodes(batch, and_codes, or_codes);
+
+    int num_output = 0;
+    for (int i = 0; i < batch->num_triangles; i++){
+        // every vertex outside the same plane
+        if (and_codes[i] != 0) continue;
+
+        vec4_t vertices[3];
+        tex2_t texcoords[3];
+        for (int j = 0; j < 3; j++){
+            vertices[j] = (vec4_t){ batch->x[j][i], batch->y[j][i], batch->z[j][i], batch->w[j][i] };
+            texcoords[j] = (tex2_t){ batch->u[j][i], batch->v[j][i] };
+        }
+
+        // inside the frustum, or only crossing side planes within the guard band where the rasterizer scissors
+        if ((or_codes[i] & ~SIDE_PLANES_OUTCODE) == 0){
+            if (num_output == max_output) break;
+            emit_triangle(vertices, texcoords, batch->color[i], batch->material, &output[num_output++]);
+            continue;
+        }
+
+        // clip against the near and far planes and the guard band planes that are actually crossed
+        polygon_t polygon = {
+            .vertices = { vertices[0], vertices[1], vertices[2] },
+            .texcoords = { texcoords[0], texcoords[1], texcoords[2] },
+            .num_vertices = 3
+        };
+        if (or_codes[i] & (1 << NEAR_FRUSTUM_PLANE)) clip_poly_against_plane(&polygon, clip_planes[NEAR_FRUSTUM_PLANE]);
+        if (or_codes[i] & (1 << FAR_FRUSTUM_PLANE)) clip_poly_against_plane(&polygon, clip_planes[FAR_FRUSTUM_PLANE]);
+        for (int plane = 0; plane < NUM_SIDE_PLANES; plane++){
+            if (or_codes[i] & (GUARD_BAND_OUTCODE << plane)) clip_poly_against_plane(&polygon, guard_band_planes[plane]);
+        }
+
+        // break polygon into a triangle fan
+        for (int k = 0; k < polygon.num_vertices - 2; k++){
+            if (num_output == max_output) break;
+
+            vec4_t fan_vertices[3] = { polygon.vertices[0], polygon.vertices[k + 1], polygon.vertices[k + 2] };
+            tex2_t fan_texcoords[3] = { polygon.texcoords[0], polygon.texcoords[k + 1], polygon.texcoords[k + 2] };
+            emit_triangle(fan_vertices, fan_texcoords, batch->color[i], batch->material, &output[num_output++]);
+        }
     }
 
-    *num_triangles = polygon->num_vertices - 2;
+    batch->num_triangles = 0;
+    return num_output;
 }
 
+int project_batch(clip_batch_t *batch, render_packet_t *output, int max_output){
+    // the whole batch is known to lie inside the guard band, nothing needs to be classified
+    int num_output = batch->num_triangles < max_output ? batch->num_triangles : max_output;
+    for (int i = 0; i < num_output; i++){
+        vec4_t vertices[3];
+        tex2_t texcoords[3];
+        for (int j = 0; j < 3; j++){
+            vertices[j] = (vec4_t){ batch->x[j][i], batch->y[j][i], batch->z[j][i], batch->w[j][i] };
+            texcoords[j] = (tex2_t){ batch->u[j][i], batch->v[j][i] };
+        }
+        emit_triangle(vertices, texcoords, batch->color[i], batch->material, &output[i]);
+    }
 
+    batch->num_triangles = 0;
+    return num_output;
+}
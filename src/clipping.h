@@ -1,10 +1,15 @@
 #ifndef CLIPPING_H
 #define CLIPPING_H
 
+#include <stdint.h>
 #include "vector.h"
 #include "triangle.h"
 #define MAX_POLY_VERTICES 10
 #define MAX_POLY_TRIANGLES 8
+// side planes of the guard band are this many times wider than the frustum
+#define GUARD_BAND_SCALE 2.0
+// triangles clipped together, a multiple of the widest SIMD width
+#define CLIP_BATCH_SIZE 64
 
 enum{
     LEFT_FRUSTUM_PLANE,
@@ -15,20 +20,49 @@ enum{
     FAR_FRUSTUM_PLANE
 };
 
+// outcode bits: (1 << plane) outside a frustum plane, (GUARD_BAND_OUTCODE << plane) outside a guard band side plane
+#define GUARD_BAND_OUTCODE (1 << 6)
+#define SIDE_PLANES_OUTCODE ((1 << LEFT_FRUSTUM_PLANE) | (1 << RIGHT_FRUSTUM_PLANE) | (1 << TOP_FRUSTUM_PLANE) | (1 << BOTTOM_FRUSTUM_PLANE))
+
+// result of testing a bounding volume against the frustum
+enum{
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECT,
+    FRUSTUM_INSIDE
+};
+
 typedef struct{
     vec3_t point;
     vec3_t normal;
 } plane_t;
 
+// polygon in homogeneous clip space
 typedef struct{
-    vec3_t vertices[MAX_POLY_VERTICES];
+    vec4_t vertices[MAX_POLY_VERTICES];
     tex2_t texcoords[MAX_POLY_VERTICES];
     int num_vertices;
 } polygon_t;
 
+// structure of arrays batch of clip space triangles from one mesh, indexed [vertex][triangle]
+typedef struct{
+    float x[3][CLIP_BATCH_SIZE];
+    float y[3][CLIP_BATCH_SIZE];
+    float z[3][CLIP_BATCH_SIZE];
+    float w[3][CLIP_BATCH_SIZE];
+    float u[3][CLIP_BATCH_SIZE];
+    float v[3][CLIP_BATCH_SIZE];
+    uint32_t color[CLIP_BATCH_SIZE];
+    uint16_t material;
+    int num_triangles;
+} clip_batch_t;
+
 void initialize_frustum_plane(float fov_x, float fov_y, float z_near, float z_far);
-polygon_t create_polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2);
-void clip_polygon(polygon_t* polygon);
-void break_polygon(polygon_t* polygon, triangle_t triangles[], int *num_triangles);
+
+vec4_t getClipPlane(int plane);
+int classify_sphere(vec3_t center, float radius);
+int compute_clip_outcode(vec4_t vertex);
+void add_to_clip_batch(clip_batch_t *batch, vec4_t vertices[3], tex2_t texcoords[3], uint32_t color);
+int clip_batch(clip_batch_t *batch, render_packet_t *output, int max_output);
+int project_batch(clip_batch_t *batch, render_packet_t *output, int max_output);
 
 #endif //CLIPPING_H
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include "display.h"
 
 static SDL_Window* window = NULL;
@@ -7,6 +8,12 @@ static SDL_Renderer* renderer = NULL;
 
 static uint32_t* color_buffer = NULL;
 static float *z_buffer = NULL;
+// triangle id per pixel for the visibility buffer mode
+static uint32_t *id_buffer = NULL;
+// farthest depth of every HIZ_BLOCK_SIZE square block of the z buffer
+static float *hiz_buffer = NULL;
+static int hiz_width = 0;
+static int hiz_height = 0;
 static SDL_Texture* color_buffer_texture = NULL;
 
 static int window_width = 800;
@@ -17,6 +24,16 @@ bool RenderMode_Wireframe = true;
 bool RenderMode_Fill = false;
 bool RenderMode_Texture = false;
 bool CullMode_Back = true;
+bool CullMode_Occlusion = true;
+bool GeometryMode_Lod = true;
+// read while meshes load, no key toggles them
+bool GeometryMode_VertexCache = true;
+// meshes loaded in this mode keep only their packed vertices
+bool GeometryMode_Quantized = true;
+bool RasterMode_Edge = true;
+bool RasterMode_Tiled = true;
+bool RasterMode_HiZ = true;
+bool RasterMode_VisBuffer = false;
 
 int getWindowWidth(void){
     return window_width;
@@ -26,16 +43,58 @@ int getWindowHeight(void){
     return window_height;
 }
 
+rect_t getScreenRect(void){
+    rect_t rect = { 0, 0, window_width - 1, window_height - 1 };
+    return rect;
+}
+
 float getZBufferAt(int x, int y){
     if (x < 0 || x >= window_width || y < 0 || y >= window_height) return 1.0;
     return z_buffer[y * window_width + x];
 }
 
+uint32_t *getColorBuffer(void){
+    return color_buffer;
+}
+
+float *getZBuffer(void){
+    return z_buffer;
+}
+
+uint32_t *getIdBuffer(void){
+    return id_buffer;
+}
+
+int getHiZWidth(void){
+    return hiz_width;
+}
+
+float *getHiZBuffer(void){
+    return hiz_buffer;
+}
+
 void setZBufferAt(int x, int y, float value){
     if (x < 0 || x >= window_width || y < 0 || y >= window_height) return;
     z_buffer[y * window_width + x] = value;
 }
 
+void update_hiz_block(int block_x, int block_y){
+    int start_x = block_x * HIZ_BLOCK_SIZE;
+    int start_y = block_y * HIZ_BLOCK_SIZE;
+    int end_x = start_x + HIZ_BLOCK_SIZE < window_width ? start_x + HIZ_BLOCK_SIZE : window_width;
+    int end_y = start_y + HIZ_BLOCK_SIZE < window_height ? start_y + HIZ_BLOCK_SIZE : window_height;
+
+    // depth only decreases while drawing, so the block maximum is recomputed after writes
+    float max_depth = 0.0;
+    for (int y = start_y; y < end_y; y++){
+        for (int x = start_x; x < end_x; x++){
+            float depth = z_buffer[y * window_width + x];
+            max_depth = depth > max_depth ? depth : max_depth;
+        }
+    }
+    hiz_buffer[block_y * hiz_width + block_x] = max_depth;
+}
+
 bool initialize_window(void) {
     // Initialize SDL
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
@@ -81,6 +140,12 @@ bool initialize_window(void) {
     color_buffer = (uint32_t*) malloc(window_width * window_height * sizeof(uint32_t));
     // allocate z buffer
     z_buffer = (float*) malloc(window_width * window_height * sizeof(float));
+    // allocate triangle id buffer
+    id_buffer = (uint32_t*) malloc(window_width * window_height * sizeof(uint32_t));
+    // allocate coarse depth buffer
+    hiz_width = (window_width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+    hiz_height = (window_height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+    hiz_buffer = (float*) malloc(hiz_width * hiz_height * sizeof(float));
 
     color_buffer_texture = SDL_CreateTexture(
             renderer,
@@ -102,9 +167,18 @@ void draw_grid(void){
 }
 
 void draw_rect(int x, int y, int width, int height, uint32_t color){
-    for (int j = y; j < y + height; j++){
-        for (int i = x; i < x + width; i++){
-            draw_pixel(i, j, color);
+    draw_clipped_rect(x, y, width, height, color, getScreenRect());
+}
+
+void draw_clipped_rect(int x, int y, int width, int height, uint32_t color, rect_t clip){
+    int start_x = x > clip.min_x ? x : clip.min_x;
+    int start_y = y > clip.min_y ? y : clip.min_y;
+    int end_x = x + width - 1 < clip.max_x ? x + width - 1 : clip.max_x;
+    int end_y = y + height - 1 < clip.max_y ? y + height - 1 : clip.max_y;
+
+    for (int j = start_y; j <= end_y; j++){
+        for (int i = start_x; i <= end_x; i++){
+            color_buffer[(j * window_width) + i] = color;
         }
     }
 }
@@ -115,6 +189,10 @@ void draw_pixel(int x, int y, uint32_t color){
 }
 
 void draw_line(int x0, int y0, int x1, int y1, uint32_t color){
+    draw_clipped_line(x0, y0, x1, y1, color, getScreenRect());
+}
+
+void draw_clipped_line(int x0, int y0, int x1, int y1, uint32_t color, rect_t clip){
     int dx = x1 - x0;
     int dy = y1 - y0;
 
@@ -127,7 +205,12 @@ void draw_line(int x0, int y0, int x1, int y1, uint32_t color){
     float current_y = y0;
 
     for (int i = 0; i <= side_length; i++){
-        draw_pixel(round(current_x), round(current_y), color);
+        int x = round(current_x);
+        int y = round(current_y);
+        // only touch pixels inside the clip rectangle
+        if (x >= clip.min_x && x <= clip.max_x && y >= clip.min_y && y <= clip.max_y){
+            color_buffer[(y * window_width) + x] = color;
+        }
         current_x += x_inc;
         current_y += y_inc;
     }
@@ -154,11 +237,21 @@ void clear_z_buffer(void){
     for (int i = 0; i < window_width * window_height; i++){
         z_buffer[i] = 1.0;
     }
+    for (int i = 0; i < hiz_width * hiz_height; i++){
+        hiz_buffer[i] = 1.0;
+    }
+}
+
+void clear_id_buffer(void){
+    // every byte set means no triangle covers the pixel
+    memset(id_buffer, 0xFF, window_width * window_height * sizeof(uint32_t));
 }
 
 void destroy_window(void){
     free(color_buffer);
     free(z_buffer);
+    free(id_buffer);
+    free(hiz_buffer);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -8,27 +8,53 @@
 #define FPS 60
 #define FRAME_TARGET_TIME (1000 / FPS)
 
+// size of the square screen blocks tracked by the coarse depth buffer
+#define HIZ_BLOCK_SIZE 8
+
+// inclusive pixel rectangle used to scissor drawing
+typedef struct {
+    int min_x, min_y, max_x, max_y;
+} rect_t;
+
 extern bool RenderMode_Vertex;
 extern bool RenderMode_Wireframe;
 extern bool RenderMode_Fill;
 extern bool RenderMode_Texture;
 extern bool CullMode_Back;
+extern bool CullMode_Occlusion;
+extern bool GeometryMode_Lod;
+extern bool GeometryMode_VertexCache;
+extern bool GeometryMode_Quantized;
+extern bool RasterMode_Edge;
+extern bool RasterMode_Tiled;
+extern bool RasterMode_HiZ;
+extern bool RasterMode_VisBuffer;
 
 int getWindowWidth(void);
 int getWindowHeight(void);
+rect_t getScreenRect(void);
 float getZBufferAt(int x, int y);
+uint32_t *getColorBuffer(void);
+float *getZBuffer(void);
+uint32_t *getIdBuffer(void);
+int getHiZWidth(void);
+float *getHiZBuffer(void);
 
 void setZBufferAt(int x, int y, float value);
+void update_hiz_block(int block_x, int block_y);
 
 bool initialize_window(void);
 void draw_grid(void);
 void draw_rect(int x, int y, int width, int height, uint32_t color);
 void draw_pixel(int x, int y, uint32_t color);
 void draw_line(int x0, int y0, int x1, int y1, uint32_t color);
+void draw_clipped_rect(int x, int y, int width, int height, uint32_t color, rect_t clip);
+void draw_clipped_line(int x0, int y0, int x1, int y1, uint32_t color, rect_t clip);
 
 void render_color_buffer(void);
 void clear_color_buffer(uint32_t color);
 void clear_z_buffer(void);
+void clear_id_buffer(void);
 void destroy_window(void);
 
 #endif //DISPLAY_H
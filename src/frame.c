@@ -0,0 +1,41 @@
+#include "frame.h"
+#include "camera.h"
+#include "display.h"
+#include "light.h"
+#include "clipping.h"
+
+static frame_constants_t frame;
+
+void init_frame_constants(mat4_t proj_matrix){
+    frame.proj_matrix = proj_matrix;
+    frame.viewport_matrix = mat4_viewport(getWindowWidth(), getWindowHeight());
+    // the light is fixed relative to the camera, so it is already in view space
+    frame.light_direction = getLightDirection();
+    // force the view matrix to be built on the first update
+    frame.camera_version = getCameraVersion() - 1;
+}
+
+void update_frame_constants(void){
+    if (frame.camera_version == getCameraVersion()) return;
+
+    // create view matrix
+    vec3_t target = getLookAtTarget();
+    vec3_t up = vec3_new(0, 1, 0);
+    frame.view_matrix = mat4_look_at(getCameraPosition(), target, up);
+
+    // pull the clip space planes back through the view projection matrix into world space
+    mat4_t view_proj_matrix = mat4_mul_mat4(frame.proj_matrix, frame.view_matrix);
+    for (int plane = 0; plane < 6; plane++){
+        vec4_t c = getClipPlane(plane);
+        float *p = &frame.frustum_planes[plane].x;
+        for (int j = 0; j < 4; j++){
+            p[j] = c.x * view_proj_matrix.m[0][j] + c.y * view_proj_matrix.m[1][j] + c.z * view_proj_matrix.m[2][j] + c.w * view_proj_matrix.m[3][j];
+        }
+    }
+
+    frame.camera_version = getCameraVersion();
+}
+
+const frame_constants_t *getFrameConstants(void){
+    return &frame;
+}
@@ -0,0 +1,23 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "matrix.h"
+#include "vector.h"
+
+// values shared by every mesh in a frame, rebuilt only when the camera moves
+typedef struct{
+    mat4_t view_matrix;
+    mat4_t proj_matrix;
+    mat4_t viewport_matrix;
+    vec3_t light_direction;
+    // world space frustum planes as (x, y, z, w) coefficients, a point is inside when the dot product is not negative
+    vec4_t frustum_planes[6];
+    // camera version the view matrix was built from, meshes compare against it
+    int camera_version;
+} frame_constants_t;
+
+void init_frame_constants(mat4_t proj_matrix);
+void update_frame_constants(void);
+const frame_constants_t *getFrameConstants(void);
+
+#endif //FRAME_H
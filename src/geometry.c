@@ -0,0 +1,291 @@
+#include <math.h>
+#include <stdbool.h>
+#include "geometry.h"
+#include "mesh.h"
+#include "array.h"
+#include "clipping.h"
+#include "light.h"
+#include "display.h"
+#include "frame.h"
+#include "queue.h"
+#include "job.h"
+#include "scene.h"
+#include "occlusion.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "arena.h"
+
+// a range of meshlets of one mesh, its faces write their triangles into the chunk's own segment
+typedef struct {
+    mesh_t *mesh;
+    int first;
+    int count;
+    int num_culled;
+    render_packet_t *triangles;
+    int output_offset;
+} geometry_chunk_t;
+
+typedef struct {
+    render_queue_t *output;
+    uint64_t *sort_keys;
+    // packet of every triangle in the segments, by the index its sort key was made with
+    render_packet_t **packets;
+    int num_triangles;
+} geometry_job_t;
+
+static int num_visible_meshes = 0;
+static int num_meshlets = 0;
+static int num_culled_meshlets = 0;
+static int num_dropped_triangles = 0;
+static geometry_chunk_t *meshlet_chunks = NULL;
+
+int getNumVisibleMeshes(void){
+    return num_visible_meshes;
+}
+
+int getNumMeshlets(void){
+    return num_meshlets;
+}
+
+int getNumCulledMeshlets(void){
+    return num_culled_meshlets;
+}
+
+int getNumDroppedTriangles(void){
+    return num_dropped_triangles;
+}
+
+static void flush_clip_batch(clip_batch_t *batch, geometry_chunk_t *chunk){
+    // reserve room for the worst case, then keep only what the clipper wrote
+    int first = array_size(chunk->triangles);
+    int max_output = batch->num_triangles * (MAX_POLY_VERTICES - 2);
+    if (max_output == 0) return;
+    chunk->triangles = array_hold(chunk->triangles, max_output, sizeof(render_packet_t));
+    int num_output = chunk->mesh->frustum_result == FRUSTUM_INSIDE ?
+        project_batch(batch, &chunk->triangles[first], max_output) :
+        clip_batch(batch, &chunk->triangles[first], max_output);
+    array_truncate(chunk->triangles, first + num_output);
+}
+
+// clip space position of a vertex, decoded by the folded matrix when the resource is stored quantized
+static vec4_t transform_vertex(const mesh_t *mesh, int index){
+    if (mesh->resource->packed_vertices != NULL){
+        const uint16_t *position = mesh->resource->packed_vertices[index].position;
+        vec4_t packed = { position[0], position[1], position[2], 1 };
+        return mat4_mul_vec4(mesh->packed_mvp_matrix, packed);
+    }
+    return mat4_mul_vec4(mesh->mvp_matrix, vec4_from_vec3(mesh->resource->vertices[index].position));
+}
+
+static tex2_t fetch_texcoord(const mesh_t *mesh, int index){
+    if (mesh->resource->packed_vertices != NULL){
+        const uint16_t *uv = mesh->resource->packed_vertices[index].uv;
+        return (tex2_t) { mesh->resource->uv_offset.u + uv[0] * mesh->resource->uv_scale.u, mesh->resource->uv_offset.v + uv[1] * mesh->resource->uv_scale.v };
+    }
+    return mesh->resource->vertices[index].uv;
+}
+
+static void process_meshlet_chunk(int job_index, void *data){
+    geometry_chunk_t *chunk = &((geometry_chunk_t*) data)[job_index];
+    mesh_t *mesh = chunk->mesh;
+    face_t *faces = mesh->resource->lod_faces[mesh->lod];
+    meshlet_set_t *set = &mesh->resource->lod_meshlets[mesh->lod];
+
+    array_clear(chunk->triangles);
+    chunk->num_culled = 0;
+
+    bool inside_frustum = mesh->frustum_result == FRUSTUM_INSIDE;
+
+    // spheres scale with the largest axis
+    float scale = mesh->max_scale;
+
+    // faces of this chunk waiting to be clipped
+    clip_batch_t batch;
+    batch.material = mesh->resource->material;
+    batch.num_triangles = 0;
+
+    // vertices of the current meshlet, transformed the first time a face that survived culling uses them
+    vec4_t clip_vertices[MESHLET_MAX_VERTICES];
+    int vertex_outcodes[MESHLET_MAX_VERTICES];
+    bool transformed[MESHLET_MAX_VERTICES];
+
+    for (int m = chunk->first; m < chunk->first + chunk->count; m++) {
+        meshlet_t *meshlet = &set->meshlets[m];
+
+        // reject the whole meshlet from its bounds before touching a vertex
+        vec3_t center = vec3_from_vec4(mat4_mul_vec4(mesh->model_view_matrix, vec4_from_vec3(meshlet->center)));
+        int result = inside_frustum ? FRUSTUM_INSIDE : classify_sphere(center, meshlet->radius * scale);
+        if (result == FRUSTUM_OUTSIDE ||
+            (CullMode_Back && is_meshlet_backfacing(meshlet, mesh->object_camera_position, mesh->winding))) {
+            chunk->num_culled++;
+            continue;
+        }
+
+        for (int i = 0; i < meshlet->num_vertices; i++) transformed[i] = false;
+
+        const int *vertex_indices = &set->vertices[meshlet->first_vertex];
+        const uint8_t *indices = &set->indices[3 * meshlet->first_face];
+        for (int i = 0; i < meshlet->num_faces; i++) {
+            face_t *mesh_face = &faces[meshlet->first_face + i];
+
+            // apply backface culling in object space, before the face's vertices are transformed
+            if (CullMode_Back && is_face_backfacing(mesh, mesh_face)) {
+                continue;
+            }
+
+            int corners[3] = { indices[3 * i], indices[3 * i + 1], indices[3 * i + 2] };
+            for (int j = 0; j < 3; j++) {
+                int corner = corners[j];
+                if (transformed[corner]) continue;
+                clip_vertices[corner] = transform_vertex(mesh, vertex_indices[corner]);
+                // a meshlet inside the frustum has nothing to reject or clip
+                vertex_outcodes[corner] = result == FRUSTUM_INSIDE ? 0 : compute_clip_outcode(clip_vertices[corner]);
+                transformed[corner] = true;
+            }
+
+            // every corner outside the same plane
+            if (vertex_outcodes[corners[0]] & vertex_outcodes[corners[1]] & vertex_outcodes[corners[2]]) {
+                continue;
+            }
+
+            // calculate shade intensity with the normal found at load time
+            float light_intensity_factor = -mesh->winding * vec3_dot(mesh_face->normal, mesh->object_light_direction);
+            // calculate color based on the light
+            uint32_t triangle_color = light_with_intensity(mesh_face->color, light_intensity_factor);
+
+            // queue the clip space face for batch clipping
+            vec4_t face_vertices[3] = { clip_vertices[corners[0]], clip_vertices[corners[1]], clip_vertices[corners[2]] };
+            tex2_t face_texcoords[3] = {
+                fetch_texcoord(mesh, vertex_indices[corners[0]]),
+                fetch_texcoord(mesh, vertex_indices[corners[1]]),
+                fetch_texcoord(mesh, vertex_indices[corners[2]])
+            };
+            add_to_clip_batch(&batch, face_vertices, face_texcoords, triangle_color);
+
+            if (batch.num_triangles == CLIP_BATCH_SIZE) {
+                flush_clip_batch(&batch, chunk);
+            }
+        }
+    }
+
+    flush_clip_batch(&batch, chunk);
+}
+
+static void key_meshlet_chunk(int job_index, void *data){
+    geometry_job_t *job = (geometry_job_t*) data;
+    geometry_chunk_t *chunk = &meshlet_chunks[job_index];
+
+    // segments past the capacity of the sort keys are left out
+    int count = array_size(chunk->triangles);
+    if (count > job->num_triangles - chunk->output_offset) count = job->num_triangles - chunk->output_offset;
+    for (int i = 0; i < count; i++) {
+        int index = chunk->output_offset + i;
+        job->packets[index] = &chunk->triangles[i];
+        job->sort_keys[index] = make_sort_key(&chunk->triangles[i], index);
+    }
+}
+
+static void gather_queue_chunk(int job_index, void *data){
+    geometry_job_t *job = (geometry_job_t*) data;
+    int first = job_index * GEOMETRY_GATHER_CHUNK;
+    int count = job->num_triangles - first < GEOMETRY_GATHER_CHUNK ? job->num_triangles - first : GEOMETRY_GATHER_CHUNK;
+    gather_render_queue(job->output, job->packets, job->sort_keys, first, count);
+}
+
+static geometry_chunk_t *add_chunks(geometry_chunk_t *chunks, int *num_chunks, mesh_t *mesh, int num_items, int chunk_size){
+    for (int first = 0; first < num_items; first += chunk_size) {
+        // reuse the output segment a chunk kept from earlier frames
+        if (*num_chunks == array_size(chunks)) {
+            geometry_chunk_t chunk = { 0 };
+            array_push(chunks, chunk);
+        }
+        geometry_chunk_t *chunk = &chunks[(*num_chunks)++];
+        chunk->mesh = mesh;
+        chunk->first = first;
+        chunk->count = num_items - first < chunk_size ? num_items - first : chunk_size;
+    }
+    return chunks;
+}
+
+int run_geometry_stage(render_queue_t *output){
+    int num_chunks = 0;
+
+    // walk the scene hierarchy for the meshes inside the frustum, their matrices are refreshed on the way
+    mesh_t **visible_meshes = cull_scene(&num_visible_meshes);
+
+    // pick the level of detail from the projected size, occluders are drawn with the faces shown on screen
+    for (int mesh_idx = 0; mesh_idx < num_visible_meshes; mesh_idx++) {
+        select_mesh_lod(visible_meshes[mesh_idx], getFrameConstants());
+    }
+
+    num_meshlets = 0;
+    if (CullMode_Occlusion) {
+        // occluders go through the vertex stage first, their triangles fill the coarse depth buffer
+        // and then the render queue like any other
+        for (int mesh_idx = 0; mesh_idx < num_visible_meshes; mesh_idx++) {
+            mesh_t *mesh = visible_meshes[mesh_idx];
+            if (!mesh->is_occluder) continue;
+            int count = array_size(mesh->resource->lod_meshlets[mesh->lod].meshlets);
+            meshlet_chunks = add_chunks(meshlet_chunks, &num_chunks, mesh, count, GEOMETRY_MESHLET_CHUNK);
+            num_meshlets += count;
+        }
+        run_jobs(process_meshlet_chunk, meshlet_chunks, num_chunks);
+
+        render_packet_t **segments = (render_packet_t**) frame_alloc(num_chunks * sizeof(render_packet_t*));
+        for (int i = 0; i < num_chunks; i++) segments[i] = meshlet_chunks[i].triangles;
+        render_occluders(segments, num_chunks);
+    }
+
+    int first_chunk = num_chunks;
+    for (int mesh_idx = 0; mesh_idx < num_visible_meshes; mesh_idx++) {
+        mesh_t *mesh = visible_meshes[mesh_idx];
+
+        // skip the whole mesh when it is hidden behind the occluders
+        if (CullMode_Occlusion && (mesh->is_occluder || is_mesh_occluded(mesh))) continue;
+
+        int count = array_size(mesh->resource->lod_meshlets[mesh->lod].meshlets);
+        meshlet_chunks = add_chunks(meshlet_chunks, &num_chunks, mesh, count, GEOMETRY_MESHLET_CHUNK);
+        num_meshlets += count;
+    }
+
+    // cull meshlets, then transform, cull, light and clip what is left, every chunk into its own segment
+    run_jobs(process_meshlet_chunk, &meshlet_chunks[first_chunk], num_chunks - first_chunk);
+
+    // place the segments in chunk order so the output does not depend on scheduling
+    int num_triangles = 0;
+    num_culled_meshlets = 0;
+    for (int i = 0; i < num_chunks; i++) {
+        meshlet_chunks[i].output_offset = num_triangles;
+        num_triangles += array_size(meshlet_chunks[i].triangles);
+        num_culled_meshlets += meshlet_chunks[i].num_culled;
+    }
+    // the sort key index cannot tell more triangles apart, the last ones in chunk order are dropped
+    num_dropped_triangles = 0;
+    if (num_triangles > MAX_RENDER_QUEUE_SIZE) {
+        num_dropped_triangles = num_triangles - MAX_RENDER_QUEUE_SIZE;
+        num_triangles = MAX_RENDER_QUEUE_SIZE;
+    }
+
+    // sort keys are made from the segments, so every packet is copied once, straight into its sorted place
+    geometry_job_t job;
+    job.output = output;
+    job.num_triangles = num_triangles;
+    job.sort_keys = (uint64_t*) frame_alloc(num_triangles * sizeof(uint64_t));
+    job.packets = (render_packet_t**) frame_alloc(num_triangles * sizeof(render_packet_t*));
+    run_jobs(key_meshlet_chunk, &job, num_chunks);
+    sort_render_keys(job.sort_keys, num_triangles);
+
+    // the render queue lives in the frame arena, sized to exactly what survived
+    alloc_render_queue(output, num_triangles);
+    run_jobs(gather_queue_chunk, &job, (num_triangles + GEOMETRY_GATHER_CHUNK - 1) / GEOMETRY_GATHER_CHUNK);
+
+    return num_triangles;
+}
+
+void free_geometry(void){
+    for (int i = 0; i < array_size(meshlet_chunks); i++) {
+        array_free(meshlet_chunks[i].triangles);
+    }
+    array_free(meshlet_chunks);
+    meshlet_chunks = NULL;
+}
@@ -0,0 +1,22 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <stdint.h>
+#include "triangle.h"
+
+// meshlets culled and processed by one geometry job
+#define GEOMETRY_MESHLET_CHUNK 16
+// render queue positions filled by one gather job
+#define GEOMETRY_GATHER_CHUNK 4096
+
+int getNumVisibleMeshes(void);
+int getNumMeshlets(void);
+int getNumCulledMeshlets(void);
+// triangles left out of the render queue last frame because it was full
+int getNumDroppedTriangles(void);
+
+// the render queue is allocated from the frame arena and ordered by the selected sort policy
+int run_geometry_stage(render_queue_t *output);
+void free_geometry(void);
+
+#endif //GEOMETRY_H
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+#include "graph.h"
+#include "array.h"
+#include "mesh.h"
+#include "scene.h"
+
+// nodes in depth first order, so every subtree is one contiguous range and an update is a single forward walk
+static scene_node_t *nodes = NULL;
+// position of every node handle in the flattened array
+static int *node_positions = NULL;
+// first position holding a dirty node, nothing before it needs updating
+static int first_dirty = -1;
+static int update_version = 0;
+static int num_updated_nodes = 0;
+
+static void mark_dirty(int position){
+    nodes[position].dirty = true;
+    if (first_dirty < 0 || position < first_dirty) first_dirty = position;
+}
+
+int add_scene_node(int parent, vec3_t scale, vec3_t rotation, vec3_t translation){
+    int parent_position = SCENE_GRAPH_ROOT;
+    if (parent != SCENE_GRAPH_ROOT){
+        if (parent < 0 || parent >= array_size(node_positions)) return -1;
+        parent_position = node_positions[parent];
+    }
+
+    // the new node closes the subtree of its parent, roots go to the end
+    int position = parent_position < 0 ? array_size(nodes) : parent_position + nodes[parent_position].subtree_size;
+    scene_node_t node = {
+        .handle = array_size(node_positions),
+        .parent = parent_position,
+        .subtree_size = 1,
+        .mesh = -1,
+        .scale = scale,
+        .rotation = rotation,
+        .translation = translation,
+        .world_version = -1
+    };
+    array_push(nodes, node);
+    int num_nodes = array_size(nodes);
+    memmove(&nodes[position + 1], &nodes[position], (num_nodes - 1 - position) * sizeof(scene_node_t));
+    nodes[position] = node;
+    array_push(node_positions, position);
+
+    // everything behind the insertion point moved up by one
+    for (int i = position + 1; i < num_nodes; i++){
+        node_positions[nodes[i].handle] = i;
+        if (nodes[i].parent >= position) nodes[i].parent++;
+    }
+    for (int ancestor = parent_position; ancestor >= 0; ancestor = nodes[ancestor].parent){
+        nodes[ancestor].subtree_size++;
+    }
+    if (first_dirty > position) first_dirty++;
+
+    mark_dirty(position);
+    return node.handle;
+}
+
+void attach_node_mesh(int node, int mesh_index){
+    mesh_t *mesh = getMesh(mesh_index);
+    if (mesh == NULL || node < 0 || node >= array_size(node_positions)) return;
+
+    int position = node_positions[node];
+    nodes[position].mesh = mesh_index;
+    mesh->node = node;
+    // the mesh picks up the world matrix on the next update
+    mark_dirty(position);
+}
+
+void set_node_transform(int node, vec3_t scale, vec3_t rotation, vec3_t translation){
+    if (node < 0 || node >= array_size(node_positions)) return;
+
+    int position = node_positions[node];
+    nodes[position].scale = scale;
+    nodes[position].rotation = rotation;
+    nodes[position].translation = translation;
+    mark_dirty(position);
+}
+
+mat4_t getNodeWorldMatrix(int node){
+    if (node < 0 || node >= array_size(node_positions)) return mat4_identity();
+    return nodes[node_positions[node]].world_matrix;
+}
+
+int getNumSceneNodes(void){
+    return array_size(nodes);
+}
+
+int getNumUpdatedNodes(void){
+    return num_updated_nodes;
+}
+
+void update_scene_graph(void){
+    num_updated_nodes = 0;
+    if (first_dirty < 0) return;
+    update_version++;
+
+    // parents come first, so a node sees the final world matrix of its parent in the same pass
+    int num_nodes = array_size(nodes);
+    for (int i = first_dirty; i < num_nodes; i++){
+        scene_node_t *node = &nodes[i];
+        bool parent_moved = node->parent >= 0 && nodes[node->parent].world_version == update_version;
+        if (!node->dirty && !parent_moved) continue;
+
+        // the euler angles are only expanded when the node itself moved
+        if (node->dirty) node->local_matrix = mat4_transform(node->scale, node->rotation, node->translation);
+        node->world_matrix = node->parent >= 0 ? mat4_mul_mat4(nodes[node->parent].world_matrix, node->local_matrix) : node->local_matrix;
+        node->world_version = update_version;
+        node->dirty = false;
+        num_updated_nodes++;
+
+        if (node->mesh >= 0){
+            mesh_t *mesh = getMesh(node->mesh);
+            mesh->model_matrix = node->world_matrix;
+            mesh->node_moved = true;
+            mark_mesh_moved(node->mesh);
+        }
+    }
+    first_dirty = -1;
+}
+
+void free_scene_graph(void){
+    array_free(nodes);
+    array_free(node_positions);
+    nodes = NULL;
+    node_positions = NULL;
+    first_dirty = -1;
+    num_updated_nodes = 0;
+}
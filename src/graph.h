@@ -0,0 +1,45 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+
+// parent of the nodes placed directly in the world
+#define SCENE_GRAPH_ROOT -1
+
+typedef struct {
+    // handle the node was created with, stays valid while nodes are inserted around it
+    int handle;
+    // position of the parent in the flattened array, parents always come before their children
+    int parent;
+    // nodes in the subtree including this one, the subtree is the range starting at the node
+    int subtree_size;
+    // mesh placed by the node, -1 for a plain group
+    int mesh;
+    vec3_t scale;
+    vec3_t rotation;
+    vec3_t translation;
+    mat4_t local_matrix;
+    mat4_t world_matrix;
+    // the local transform changed since the last update
+    bool dirty;
+    // update pass in which the world matrix last changed
+    int world_version;
+} scene_node_t;
+
+// adds a node below parent, a node handle or SCENE_GRAPH_ROOT, and returns its handle
+int add_scene_node(int parent, vec3_t scale, vec3_t rotation, vec3_t translation);
+// hands the model matrix of the mesh over to the node
+void attach_node_mesh(int node, int mesh_index);
+// moves the node and with it its whole subtree
+void set_node_transform(int node, vec3_t scale, vec3_t rotation, vec3_t translation);
+mat4_t getNodeWorldMatrix(int node);
+int getNumSceneNodes(void);
+int getNumUpdatedNodes(void);
+
+// recomputes the world matrices of the subtrees below moved nodes
+void update_scene_graph(void);
+void free_scene_graph(void);
+
+#endif //GRAPH_H
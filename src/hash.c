@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hash.h"
+
+// free slots hold this value, stored values are never negative
+#define HASH_EMPTY -1
+
+static uint32_t hash_key(const uint32_t key[3]){
+    // multiply and xor each word into the hash, then mix the high bits down
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 3; i++){
+        hash = (hash ^ key[i]) * 16777619u;
+        hash ^= hash >> 15;
+    }
+    return hash;
+}
+
+static void alloc_entries(hash_map_t *map, int capacity){
+    map->entries = (hash_entry_t*) malloc(capacity * sizeof(hash_entry_t));
+    map->capacity = capacity;
+    map->count = 0;
+    for (int i = 0; i < capacity; i++){
+        map->entries[i].value = HASH_EMPTY;
+    }
+}
+
+void init_hash_map(hash_map_t *map, int expected_count){
+    // a power of two at most half full
+    int capacity = 16;
+    while (capacity < expected_count * 2) capacity *= 2;
+    alloc_entries(map, capacity);
+}
+
+static bool same_key(const uint32_t a[3], const uint32_t b[3]){
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+static void grow_hash_map(hash_map_t *map){
+    hash_entry_t *old_entries = map->entries;
+    int old_capacity = map->capacity;
+    alloc_entries(map, old_capacity * 2);
+    for (int i = 0; i < old_capacity; i++){
+        if (old_entries[i].value != HASH_EMPTY) hash_map_insert(map, old_entries[i].key, old_entries[i].value);
+    }
+    free(old_entries);
+}
+
+int hash_map_insert(hash_map_t *map, const uint32_t key[3], int value){
+    if ((map->count + 1) * 2 > map->capacity) grow_hash_map(map);
+
+    // linear probing from the hashed slot
+    int mask = map->capacity - 1;
+    int slot = hash_key(key) & mask;
+    while (map->entries[slot].value != HASH_EMPTY){
+        if (same_key(map->entries[slot].key, key)) return map->entries[slot].value;
+        slot = (slot + 1) & mask;
+    }
+
+    hash_entry_t *entry = &map->entries[slot];
+    entry->key[0] = key[0];
+    entry->key[1] = key[1];
+    entry->key[2] = key[2];
+    entry->value = value;
+    map->count++;
+    return value;
+}
+
+void free_hash_map(hash_map_t *map){
+    free(map->entries);
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+int weld_vertex_positions(const mesh_vertex_t *vertices, int num_vertices, int *vertex_positions){
+    int num_positions = 0;
+    hash_map_t position_map;
+    init_hash_map(&position_map, num_vertices);
+    for (int i = 0; i < num_vertices; i++){
+        uint32_t key[3];
+        memcpy(key, &vertices[i].position, sizeof(key));
+        vertex_positions[i] = hash_map_insert(&position_map, key, num_positions);
+        if (vertex_positions[i] == num_positions) num_positions++;
+    }
+    free_hash_map(&position_map);
+    return num_positions;
+}
@@ -0,0 +1,27 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include "triangle.h"
+
+// open addressing map from three 32 bit words to an int, used to weld vertices
+typedef struct {
+    uint32_t key[3];
+    int value;
+} hash_entry_t;
+
+typedef struct {
+    hash_entry_t *entries;
+    int capacity;
+    int count;
+} hash_map_t;
+
+void init_hash_map(hash_map_t *map, int expected_count);
+// value stored for key, inserting value first when the key is new
+int hash_map_insert(hash_map_t *map, const uint32_t key[3], int value);
+void free_hash_map(hash_map_t *map);
+
+// welds vertices with bitwise equal positions, writes the position index of every vertex and returns the number of positions
+int weld_vertex_positions(const mesh_vertex_t *vertices, int num_vertices, int *vertex_positions);
+
+#endif //HASH_H
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include "job.h"
+
+#define MAX_JOB_THREADS 64
+
+static SDL_Thread *workers[MAX_JOB_THREADS];
+static int num_workers = 0;
+
+static SDL_sem *start_semaphore = NULL;
+static SDL_sem *done_semaphore = NULL;
+
+static job_function_t current_function = NULL;
+static void *current_data = NULL;
+static int current_num_jobs = 0;
+static SDL_atomic_t next_job;
+static bool is_shutting_down = false;
+
+static void process_jobs(void){
+    // grab job indices until every job of the current batch is taken
+    int job_index = SDL_AtomicAdd(&next_job, 1);
+    while (job_index < current_num_jobs){
+        current_function(job_index, current_data);
+        job_index = SDL_AtomicAdd(&next_job, 1);
+    }
+}
+
+static int worker_main(void *data){
+    while (true){
+        SDL_SemWait(start_semaphore);
+        if (is_shutting_down) break;
+
+        process_jobs();
+        SDL_SemPost(done_semaphore);
+    }
+    return 0;
+}
+
+void init_job_system(int num_threads){
+    // zero means one thread per logical core, the calling thread counts as one of them
+    if (num_threads <= 0) num_threads = SDL_GetCPUCount();
+    if (num_threads > MAX_JOB_THREADS) num_threads = MAX_JOB_THREADS;
+
+    start_semaphore = SDL_CreateSemaphore(0);
+    done_semaphore = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&next_job, 0);
+
+    num_workers = 0;
+    for (int i = 1; i < num_threads; i++){
+        SDL_Thread *worker = SDL_CreateThread(worker_main, "job worker", NULL);
+        if (worker == NULL) {
+            fprintf(stderr, "Error creating job worker thread.\n");
+            break;
+        }
+        workers[num_workers++] = worker;
+    }
+}
+
+int getNumJobThreads(void){
+    return num_workers + 1;
+}
+
+void run_jobs(job_function_t function, void *data, int num_jobs){
+    if (num_jobs <= 0) return;
+
+    current_function = function;
+    current_data = data;
+    current_num_jobs = num_jobs;
+    SDL_AtomicSet(&next_job, 0);
+
+    // no point in waking more workers than there are jobs
+    int num_woken = num_jobs - 1 < num_workers ? num_jobs - 1 : num_workers;
+    for (int i = 0; i < num_woken; i++){
+        SDL_SemPost(start_semaphore);
+    }
+
+    // the calling thread works too, then waits for the rest of the batch
+    process_jobs();
+    for (int i = 0; i < num_woken; i++){
+        SDL_SemWait(done_semaphore);
+    }
+}
+
+void free_job_system(void){
+    is_shutting_down = true;
+    for (int i = 0; i < num_workers; i++){
+        SDL_SemPost(start_semaphore);
+    }
+    for (int i = 0; i < num_workers; i++){
+        SDL_WaitThread(workers[i], NULL);
+    }
+    num_workers = 0;
+
+    SDL_DestroySemaphore(start_semaphore);
+    SDL_DestroySemaphore(done_semaphore);
+}
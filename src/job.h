@@ -0,0 +1,14 @@
+#ifndef JOB_H
+#define JOB_H
+
+// called once for every job index, possibly from several threads at once
+typedef void (*job_function_t)(int job_index, void *data);
+
+void init_job_system(int num_threads);
+int getNumJobThreads(void);
+
+void run_jobs(job_function_t function, void *data, int num_jobs);
+
+void free_job_system(void);
+
+#endif //JOB_H
@@ -0,0 +1,420 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lod.h"
+#include "array.h"
+#include "display.h"
+#include "hash.h"
+
+// symmetric 4x4 error quadric, a11 a12 a13 a14 a22 a23 a24 a33 a34 a44
+typedef struct {
+    double q[10];
+} quadric_t;
+
+// collapse of vertex from onto vertex to, valid while both versions are unchanged
+typedef struct {
+    double cost;
+    int from, to;
+    int from_version, to_version;
+} collapse_t;
+
+// topology runs on welded positions, so vertices split by texture seams or normals stay connected
+typedef struct {
+    int positions[3];
+    // vertex buffer entry each corner is drawn with
+    uint32_t vertices[3];
+} simple_face_t;
+
+typedef struct {
+    simple_face_t *faces;
+    bool *face_removed;
+    int num_faces;
+
+    // vertices below are welded positions
+    int num_vertices;
+    vec3_t *positions;
+    quadric_t *quadrics;
+    // faces around every vertex, dynamic arrays of face indices
+    int **vertex_faces;
+    int *versions;
+    // seam and boundary vertices keep their place so texture charts and outlines stay intact
+    bool *locked;
+
+    collapse_t *heap;
+} simplifier_t;
+
+// corner of the face using vertex, -1 when it is not used
+static int find_corner(simple_face_t *face, int vertex){
+    for (int corner = 0; corner < 3; corner++){
+        if (face->positions[corner] == vertex) return corner;
+    }
+    return -1;
+}
+
+static void quadric_add_plane(quadric_t *quadric, double a, double b, double c, double d, double weight){
+    double *q = quadric->q;
+    q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+    q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+    q[7] += weight * c * c; q[8] += weight * c * d;
+    q[9] += weight * d * d;
+}
+
+static double quadric_error(quadric_t *a, quadric_t *b, vec3_t v){
+    double q[10];
+    for (int i = 0; i < 10; i++) q[i] = a->q[i] + b->q[i];
+    double x = v.x, y = v.y, z = v.z;
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+         + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+         + q[7] * z * z + 2 * q[8] * z
+         + q[9];
+}
+
+static vec3_t face_cross(simplifier_t *s, simple_face_t *face, int moved, vec3_t moved_position){
+    vec3_t p[3];
+    for (int i = 0; i < 3; i++){
+        int vertex = face->positions[i];
+        p[i] = vertex == moved ? moved_position : s->positions[vertex];
+    }
+    return vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+}
+
+static void heap_push(simplifier_t *s, collapse_t collapse){
+    array_push(s->heap, collapse);
+    int i = array_size(s->heap) - 1;
+    while (i > 0){
+        int parent = (i - 1) / 2;
+        if (s->heap[parent].cost <= s->heap[i].cost) break;
+        collapse_t swap = s->heap[parent];
+        s->heap[parent] = s->heap[i];
+        s->heap[i] = swap;
+        i = parent;
+    }
+}
+
+static collapse_t heap_pop(simplifier_t *s){
+    collapse_t top = s->heap[0];
+    int size = array_size(s->heap) - 1;
+    s->heap[0] = s->heap[size];
+    array_truncate(s->heap, size);
+
+    int i = 0;
+    while (true){
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < size && s->heap[left].cost < s->heap[smallest].cost) smallest = left;
+        if (right < size && s->heap[right].cost < s->heap[smallest].cost) smallest = right;
+        if (smallest == i) break;
+        collapse_t swap = s->heap[smallest];
+        s->heap[smallest] = s->heap[i];
+        s->heap[i] = swap;
+        i = smallest;
+    }
+    return top;
+}
+
+static void push_collapse(simplifier_t *s, int from, int to){
+    if (s->locked[from]) return;
+    collapse_t collapse = {
+        .cost = quadric_error(&s->quadrics[from], &s->quadrics[to], s->positions[to]),
+        .from = from,
+        .to = to,
+        .from_version = s->versions[from],
+        .to_version = s->versions[to]
+    };
+    heap_push(s, collapse);
+}
+
+// queue the collapses of vertex onto each of its neighbors and of each neighbor onto it
+static void push_vertex_collapses(simplifier_t *s, int vertex){
+    int *faces = s->vertex_faces[vertex];
+    for (int i = 0; i < array_size(faces); i++){
+        simple_face_t *face = &s->faces[faces[i]];
+        for (int corner = 0; corner < 3; corner++){
+            int neighbor = face->positions[corner];
+            if (neighbor == vertex) continue;
+            push_collapse(s, vertex, neighbor);
+            push_collapse(s, neighbor, vertex);
+        }
+    }
+}
+
+static int count_shared_faces(simplifier_t *s, int a, int b){
+    int count = 0;
+    int *faces = s->vertex_faces[a];
+    for (int i = 0; i < array_size(faces); i++){
+        if (find_corner(&s->faces[faces[i]], b) >= 0) count++;
+    }
+    return count;
+}
+
+static bool is_neighbor(simplifier_t *s, int a, int b){
+    return count_shared_faces(s, a, b) > 0;
+}
+
+static bool can_collapse(simplifier_t *s, int from, int to){
+    int *faces = s->vertex_faces[from];
+
+    // the edge must be shared by two faces, and the two vertices may not share any other neighbor
+    int shared_faces = count_shared_faces(s, from, to);
+    if (shared_faces != 2) return false;
+    int shared_neighbors = 0;
+    for (int i = 0; i < array_size(faces); i++){
+        simple_face_t *face = &s->faces[faces[i]];
+        for (int corner = 0; corner < 3; corner++){
+            int neighbor = face->positions[corner];
+            if (neighbor == from || neighbor == to) continue;
+            // every neighbor shows up twice around a closed fan
+            if (is_neighbor(s, neighbor, to)) shared_neighbors++;
+        }
+    }
+    if (shared_neighbors != 2 * shared_faces) return false;
+
+    // the faces that remain may not flip or degenerate
+    for (int i = 0; i < array_size(faces); i++){
+        simple_face_t *face = &s->faces[faces[i]];
+        if (find_corner(face, to) >= 0) continue;
+        vec3_t before = face_cross(s, face, -1, s->positions[from]);
+        vec3_t after = face_cross(s, face, from, s->positions[to]);
+        if (vec3_dot(before, after) <= 0.05 * vec3_length(before) * vec3_length(after)) return false;
+    }
+    return true;
+}
+
+static void collapse_edge(simplifier_t *s, int from, int to){
+    int *faces = s->vertex_faces[from];
+
+    // vertex of to inside the chart of from, read from a face on the edge
+    uint32_t to_vertex = 0;
+    for (int i = 0; i < array_size(faces); i++){
+        simple_face_t *face = &s->faces[faces[i]];
+        int corner = find_corner(face, to);
+        if (corner >= 0){
+            to_vertex = face->vertices[corner];
+            break;
+        }
+    }
+
+    for (int i = 0; i < array_size(faces); i++){
+        int face_index = faces[i];
+        simple_face_t *face = &s->faces[face_index];
+
+        if (find_corner(face, to) >= 0){
+            // faces on the edge collapse to nothing
+            s->face_removed[face_index] = true;
+            s->num_faces--;
+            int *to_faces = s->vertex_faces[to];
+            int size = array_size(to_faces);
+            for (int j = 0; j < size; j++){
+                if (to_faces[j] == face_index){
+                    to_faces[j] = to_faces[size - 1];
+                    array_truncate(to_faces, size - 1);
+                    break;
+                }
+            }
+            for (int corner = 0; corner < 3; corner++){
+                int other = face->positions[corner];
+                if (other == from || other == to) continue;
+                int *other_faces = s->vertex_faces[other];
+                int other_size = array_size(other_faces);
+                for (int j = 0; j < other_size; j++){
+                    if (other_faces[j] == face_index){
+                        other_faces[j] = other_faces[other_size - 1];
+                        array_truncate(other_faces, other_size - 1);
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+
+        int corner = find_corner(face, from);
+        face->positions[corner] = to;
+        face->vertices[corner] = to_vertex;
+        array_push(s->vertex_faces[to], face_index);
+    }
+
+    for (int i = 0; i < 10; i++){
+        s->quadrics[to].q[i] += s->quadrics[from].q[i];
+    }
+    array_clear(s->vertex_faces[from]);
+    s->versions[from]++;
+    s->versions[to]++;
+    s->locked[from] = true;
+
+    // costs of every collapse touching to changed with its quadric
+    push_vertex_collapses(s, to);
+}
+
+static void init_simplifier(simplifier_t *s, mesh_resource_t *resource){
+    memset(s, 0, sizeof(simplifier_t));
+    int num_mesh_vertices = array_size(resource->vertices);
+    s->num_faces = array_size(resource->faces);
+
+    // weld vertices with bitwise equal positions
+    int *vertex_positions = (int*) malloc(num_mesh_vertices * sizeof(int));
+    s->num_vertices = weld_vertex_positions(resource->vertices, num_mesh_vertices, vertex_positions);
+    s->positions = (vec3_t*) malloc(s->num_vertices * sizeof(vec3_t));
+    for (int i = 0; i < num_mesh_vertices; i++){
+        s->positions[vertex_positions[i]] = resource->vertices[i].position;
+    }
+
+    s->faces = (simple_face_t*) malloc(s->num_faces * sizeof(simple_face_t));
+    s->face_removed = (bool*) calloc(s->num_faces, sizeof(bool));
+    s->quadrics = (quadric_t*) calloc(s->num_vertices, sizeof(quadric_t));
+    s->vertex_faces = (int**) calloc(s->num_vertices, sizeof(int*));
+    s->versions = (int*) calloc(s->num_vertices, sizeof(int));
+    s->locked = (bool*) calloc(s->num_vertices, sizeof(bool));
+
+    // a position shared by vertices with two texture coordinates sits on a seam
+    int *position_vertex = (int*) malloc(s->num_vertices * sizeof(int));
+    for (int i = 0; i < s->num_vertices; i++) position_vertex[i] = -1;
+    for (int i = 0; i < num_mesh_vertices; i++){
+        int position = vertex_positions[i];
+        if (position_vertex[position] < 0){
+            position_vertex[position] = i;
+            continue;
+        }
+        tex2_t uv = resource->vertices[position_vertex[position]].uv;
+        if (uv.u != resource->vertices[i].uv.u || uv.v != resource->vertices[i].uv.v) s->locked[position] = true;
+    }
+
+    for (int i = 0; i < s->num_faces; i++){
+        simple_face_t *face = &s->faces[i];
+        face->vertices[0] = resource->faces[i].a;
+        face->vertices[1] = resource->faces[i].b;
+        face->vertices[2] = resource->faces[i].c;
+        for (int corner = 0; corner < 3; corner++){
+            face->positions[corner] = vertex_positions[face->vertices[corner]];
+        }
+
+        vec3_t normal = face_cross(s, face, -1, vec3_new(0, 0, 0));
+        double area = vec3_length(normal);
+
+        // area weighted plane of the face
+        if (area > 0){
+            vec3_t p = s->positions[face->positions[0]];
+            double a = normal.x / area, b = normal.y / area, c = normal.z / area;
+            double d = -(a * p.x + b * p.y + c * p.z);
+            for (int corner = 0; corner < 3; corner++){
+                quadric_add_plane(&s->quadrics[face->positions[corner]], a, b, c, d, area);
+            }
+        }
+
+        for (int corner = 0; corner < 3; corner++){
+            array_push(s->vertex_faces[face->positions[corner]], i);
+        }
+    }
+
+    // an edge used by a single face lies on the boundary
+    for (int i = 0; i < s->num_faces; i++){
+        simple_face_t *face = &s->faces[i];
+        for (int corner = 0; corner < 3; corner++){
+            int a = face->positions[corner];
+            int b = face->positions[(corner + 1) % 3];
+            if (count_shared_faces(s, a, b) < 2){
+                s->locked[a] = true;
+                s->locked[b] = true;
+            }
+        }
+    }
+
+    free(position_vertex);
+    free(vertex_positions);
+
+    for (int vertex = 0; vertex < s->num_vertices; vertex++){
+        if (!s->locked[vertex]) push_vertex_collapses(s, vertex);
+    }
+}
+
+static void free_simplifier(simplifier_t *s){
+    for (int i = 0; i < s->num_vertices; i++){
+        array_free(s->vertex_faces[i]);
+    }
+    free(s->positions);
+    free(s->faces);
+    free(s->face_removed);
+    free(s->quadrics);
+    free(s->vertex_faces);
+    free(s->versions);
+    free(s->locked);
+    array_free(s->heap);
+}
+
+void build_mesh_lods(mesh_resource_t *resource){
+    resource->lod_faces[0] = resource->faces;
+    resource->num_lods = 1;
+
+    int num_faces = array_size(resource->faces);
+    if (num_faces == 0) return;
+
+    simplifier_t s;
+    init_simplifier(&s, resource);
+
+    int target = num_faces;
+    while (resource->num_lods < MAX_LODS){
+        // every level keeps half the faces of the one before
+        target /= 2;
+        while (s.num_faces > target && array_size(s.heap) > 0){
+            collapse_t collapse = heap_pop(&s);
+            if (collapse.from_version != s.versions[collapse.from] || collapse.to_version != s.versions[collapse.to]) continue;
+            if (s.locked[collapse.from] || !can_collapse(&s, collapse.from, collapse.to)) continue;
+            collapse_edge(&s, collapse.from, collapse.to);
+        }
+
+        // stop once locked vertices keep the mesh from shrinking any further
+        int previous_faces = array_size(resource->lod_faces[resource->num_lods - 1]);
+        if (s.num_faces > previous_faces * 0.75) break;
+
+        face_t *faces = NULL;
+        for (int i = 0; i < array_size(resource->faces); i++){
+            if (s.face_removed[i]) continue;
+            face_t face = resource->faces[i];
+            face.a = s.faces[i].vertices[0];
+            face.b = s.faces[i].vertices[1];
+            face.c = s.faces[i].vertices[2];
+            array_push(faces, face);
+        }
+        compute_face_planes(faces, resource->vertices);
+        resource->lod_faces[resource->num_lods++] = faces;
+    }
+
+    free_simplifier(&s);
+}
+
+void select_mesh_lod(mesh_t *mesh, const frame_constants_t *frame){
+    if (!GeometryMode_Lod || mesh->resource->num_lods == 1){
+        mesh->lod = 0;
+        return;
+    }
+
+    // projected radius of the bounding sphere in pixels
+    vec4_t center = mat4_mul_vec4(mesh->model_view_matrix, vec4_from_vec3(mesh->resource->bounds_center));
+    float radius = mesh->resource->bounds_radius * mesh->max_scale;
+    if (center.z <= radius){
+        mesh->lod = 0;
+        return;
+    }
+    float screen_radius = radius * frame->proj_matrix.m[1][1] / center.z * getWindowHeight() / 2.0;
+
+    // level whose switch radius the mesh has fallen below
+    int lod = 0;
+    float switch_radius = LOD_SWITCH_RADIUS;
+    while (lod < mesh->resource->num_lods - 1){
+        // a level is only left once its switch radius is passed by a margin
+        float margin = lod < mesh->lod ? 1.0 + LOD_HYSTERESIS : 1.0 - LOD_HYSTERESIS;
+        if (screen_radius >= switch_radius * margin) break;
+        lod++;
+        switch_radius /= 2;
+    }
+    mesh->lod = lod;
+}
+
+void free_mesh_lods(mesh_resource_t *resource){
+    for (int i = 1; i < resource->num_lods; i++){
+        array_free(resource->lod_faces[i]);
+        resource->lod_faces[i] = NULL;
+    }
+    resource->num_lods = 1;
+}
@@ -0,0 +1,15 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "mesh.h"
+
+// projected radius in pixels below which the first simplified level is used, halved for every further level
+#define LOD_SWITCH_RADIUS 160.0
+// fraction a switch radius must be passed by before the level changes, keeps meshes from flickering between levels
+#define LOD_HYSTERESIS 0.15
+
+void build_mesh_lods(mesh_resource_t *resource);
+void select_mesh_lod(mesh_t *mesh, const frame_constants_t *frame);
+void free_mesh_lods(mesh_resource_t *resource);
+
+#endif //LOD_H
@@ -12,20 +12,38 @@
 #include "upng.h"
 #include "camera.h"
 #include "clipping.h"
-
-#define MAX_TRIANGLES_PER_MESH 10000
-triangle_t triangles_to_render[MAX_TRIANGLES_PER_MESH];
+#include "job.h"
+#include "tile.h"
+#include "visibility.h"
+#include "queue.h"
+#include "frame.h"
+#include "geometry.h"
+#include "scene.h"
+#include "graph.h"
+#include "occlusion.h"
+#include "arena.h"
+
+// render queue of the current frame, allocated from the frame arena
+render_queue_t render_queue = { 0 };
 int num_triangles_to_render = 0;
 
+// number of threads used for rasterization, zero uses one per logical core
+#define NUM_RENDER_THREADS 0
+
 bool is_running = false;
 int previous_frame_time = 0;
 float delta_time = 0.0;
 
-mat4_t world_matrix;
-mat4_t proj_matrix;
-mat4_t view_matrix;
+bool show_stats = false;
+int previous_stats_time = 0;
 
 void setup(void){
+    // initialize worker threads, per frame memory and screen tiles
+    init_job_system(NUM_RENDER_THREADS);
+    init_frame_arena(FRAME_ARENA_INITIAL_SIZE);
+    init_tile_renderer();
+    init_occlusion();
+
     // initialize scene light
     init_light(vec3_new(0, 0, 1));
     // initialize camera
@@ -38,7 +56,8 @@ void setup(void){
     float fov_x = atan(tan(fov_y / 2) * aspect_x) * 2.0;
     float z_near = 0.5;
     float z_far = 60.0;
-    proj_matrix = mat4_perspective(fov_y, aspect_y, z_near, z_far);
+    mat4_t proj_matrix = mat4_perspective(fov_y, aspect_y, z_near, z_far);
+    init_frame_constants(proj_matrix);
 
     // initialize frustum planes
     initialize_frustum_plane(fov_x, fov_y, z_near, z_far);
@@ -72,6 +91,8 @@ void setup(void){
             vec3_new(0, 0, 0),
             vec3_new(0, -1.5, 23)
     );
+    // the runway hides whatever lies below it
+    setMeshOccluder(getNumMeshes() - 1, true);
 }
 
 void process_input(void){
@@ -102,10 +123,43 @@ void process_input(void){
                     RenderMode_Texture = !RenderMode_Texture;
                     break;
                 }
+                if (event.key.keysym.sym == SDLK_5){
+                    RasterMode_Edge = !RasterMode_Edge;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_6){
+                    RasterMode_Tiled = !RasterMode_Tiled;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_7){
+                    RasterMode_HiZ = !RasterMode_HiZ;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_8){
+                    RasterMode_VisBuffer = !RasterMode_VisBuffer;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_9){
+                    SortMode_Policy = (SortMode_Policy + 1) % NUM_SORT_POLICIES;
+                    printf("sort policy: %s\n", getSortPolicyName(SortMode_Policy));
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_TAB){
+                    show_stats = !show_stats;
+                    break;
+                }
                 if (event.key.keysym.sym == SDLK_RETURN){
                     CullMode_Back = !CullMode_Back;
                     break;
                 }
+                if (event.key.keysym.sym == SDLK_o){
+                    CullMode_Occlusion = !CullMode_Occlusion;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_l){
+                    GeometryMode_Lod = !GeometryMode_Lod;
+                    break;
+                }
                 if (event.key.keysym.sym == SDLK_w){
                     setCameraForwardVelocity(vec3_mul(getCameraDirection(), 5.0 * delta_time));
                     setCameraPosition(vec3_add(getCameraPosition(), getCameraForwardVelocity()));
@@ -153,127 +207,16 @@ void process_input(void){
     }
 }
 
-void process_graphic_pipeline_stages(mesh_t *mesh){
-    // create transformation matrix
-    mat4_t scale_matrix = mat4_scale(mesh->scale.x, mesh->scale.y, mesh->scale.z);
-    mat4_t translation_matrix = mat4_translation(mesh->translation.x, mesh->translation.y, mesh->translation.z);
-    mat4_t rotation_matrix_x = mat4_rotation_x(mesh->rotation.x);
-    mat4_t rotation_matrix_y = mat4_rotation_y(mesh->rotation.y);
-    mat4_t rotation_matrix_z = mat4_rotation_z(mesh->rotation.z);
-
-    // initialize target
-    vec3_t target = getLookAtTarget();
-    vec3_t up = vec3_new(0, 1, 0);
-    // create view matrix
-    view_matrix = mat4_look_at(getCameraPosition(), target, up);
-
-    int num_faces = array_size(mesh->faces);
-    for (int i = 0; i < num_faces; i++) {
-        face_t mesh_face = mesh->faces[i];
-
-        // set face vertices
-        vec3_t face_vertices[3];
-        face_vertices[0] = mesh->vertices[mesh_face.a - 1];
-        face_vertices[1] = mesh->vertices[mesh_face.b - 1];
-        face_vertices[2] = mesh->vertices[mesh_face.c - 1];
-
-        vec4_t transformed_vertices[3];
-
-        // Loop through each vertex in the face and apply transformation
-        for (int j = 0; j < 3; j++) {
-            vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
-
-            // init world matrix
-            world_matrix = mat4_identity();
-            // multiply scale matrix
-            world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
-            // multiply rotation matrix
-            world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-            world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-            world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-            // multiply translation matrix
-            world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
-            // multiply world matrix
-            transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
-
-            // multiply view matrix
-            transformed_vertex = mat4_mul_vec4(view_matrix, transformed_vertex);
+void print_frame_stats(void){
+    // report once per second
+    if (!show_stats || SDL_GetTicks() - previous_stats_time < 1000) return;
+    previous_stats_time = SDL_GetTicks();
 
-            transformed_vertices[j] = transformed_vertex;
-        }
-
-        // apply backface culling
-        vec3_t face_normal = getTriangleNormal(transformed_vertices);
-
-        if (CullMode_Back) {
-            vec3_t camera_ray = vec3_sub(vec3_new(0, 0, 0), vec3_from_vec4(transformed_vertices[0]));
-            if (vec3_dot(face_normal, camera_ray) < 0) {
-                continue;
-            }
-        }
-
-        // create polygon for clipping
-        polygon_t polygon = create_polygon_from_triangle(
-            vec3_from_vec4(transformed_vertices[0]),
-            vec3_from_vec4(transformed_vertices[1]),
-            vec3_from_vec4(transformed_vertices[2]),
-            mesh_face.a_uv,
-            mesh_face.b_uv,
-            mesh_face.c_uv
-        );
-
-        // apply clipping
-        clip_polygon(&polygon);
-        // break polygon into triangle
-        triangle_t triangles_clipped[MAX_POLY_TRIANGLES];
-        int num_triangles_clipped = 0;
-        break_polygon(&polygon, triangles_clipped, &num_triangles_clipped);
-
-        // apply projection for clipped triangles
-        for (int k = 0; k < num_triangles_clipped; k++) {
-            triangle_t triangle = triangles_clipped[k];
-
-            vec4_t projected_points[3];
-
-            // Loop through each vertex in the face and project it to 2d
-            for (int j = 0; j < 3; j++) {
-                // project point to 2d
-                projected_points[j] = mat4_project(proj_matrix, triangle.points[j]);
-
-                // scale point to fit the screen
-                projected_points[j].x *= (getWindowWidth() / 2.0);
-                projected_points[j].y *= -(getWindowHeight() / 2.0);
-                // translate point to center of the screen
-                projected_points[j].x += (getWindowWidth() / 2.0);
-                projected_points[j].y += (getWindowHeight() / 2.0);
-            }
-
-            // calculate shade intensity
-            float light_intensity_factor = -vec3_dot(face_normal, getLightDirection());
-            // calculate color based on the light
-            uint32_t triangle_color = light_with_intensity(mesh_face.color, light_intensity_factor);
-
-            // set triangle to be rendered
-            triangle_t render_triangle = {
-                    .points = {
-                            {projected_points[0].x, projected_points[0].y, projected_points[0].z, projected_points[0].w},
-                            {projected_points[1].x, projected_points[1].y, projected_points[1].z, projected_points[1].w},
-                            {projected_points[2].x, projected_points[2].y, projected_points[2].z, projected_points[2].w}
-                    },
-                    .tex_coords = {
-                            {triangle.tex_coords[0].u, triangle.tex_coords[0].v},
-                            {triangle.tex_coords[1].u, triangle.tex_coords[1].v},
-                            {triangle.tex_coords[2].u, triangle.tex_coords[2].v}
-                    },
-                    .color = triangle_color,
-                    .texture = mesh->texture
-            };
-
-            if (num_triangles_to_render < MAX_TRIANGLES_PER_MESH) {
-                triangles_to_render[num_triangles_to_render++] = render_triangle;
-            }
-        }
-    }
+    printf("meshes: %d/%d (%d resources), updated nodes: %d/%d, occluded meshes: %d (%d triangles), culled meshlets: %d/%d, triangles: %d (%d dropped), sort (%s): %.3f ms, frame arena peak: %d/%d KB\n",
+        getNumVisibleMeshes(), getNumMeshes(), getNumMeshResources(), getNumUpdatedNodes(), getNumSceneNodes(), getOccludedMeshCount(), getOccludedTriangleCount(),
+        getNumCulledMeshlets(), getNumMeshlets(), num_triangles_to_render, getNumDroppedTriangles(), getSortPolicyName(SortMode_Policy), getSortTime(),
+        getFrameArenaPeak() / 1024, getFrameArenaCapacity() / 1024
+    );
 }
 
 void update(void){
@@ -289,10 +232,11 @@ void update(void){
     // update previous frame time
     previous_frame_time = SDL_GetTicks();
 
-    num_triangles_to_render = 0;
+    // rebuild the view matrix only if the camera moved
+    update_frame_constants();
 
-    for (int mesh_idx = 0; mesh_idx < getNumMeshes(); mesh_idx++) {
-        mesh_t *mesh = getMesh(mesh_idx);
+    // for (int mesh_idx = 0; mesh_idx < getNumMeshes(); mesh_idx++) {
+    //    mesh_t *mesh = getMesh(mesh_idx);
         // change values per frame
         //    mesh.rotation.x += 0.6 * delta_time;
         //    mesh.rotation.y += 0.6 * delta_time;
@@ -305,10 +249,20 @@ void update(void){
         //    mesh.translation.x += 0.01 * delta_time;
         //    mesh.translation.y += 0.01 * delta_time;
         //    mesh.translation.z = 5.0;
+    // }
 
-        // process mesh
-        process_graphic_pipeline_stages(mesh);
-    }
+    // push moved nodes down to the meshes they place
+    update_scene_graph();
+    // refit the scene hierarchy around meshes that moved
+    update_scene();
+
+    // everything the last frame allocated is released at once
+    reset_frame_arena();
+
+    // transform, cull, light and clip every mesh across the worker threads, ordered by the selected policy
+    num_triangles_to_render = run_geometry_stage(&render_queue);
+
+    print_frame_stats();
 }
 
 void render(void){
@@ -318,38 +272,16 @@ void render(void){
 
     draw_grid();
 
-    // apply different render mode
-    for (int i = 0; i < num_triangles_to_render; i++){
-        triangle_t triangle = triangles_to_render[i];
-
-        if (RenderMode_Fill){
-            draw_filled_triangle(
-                triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w,
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w,
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w,
-                triangle.color
-            );
-        }
-        if (RenderMode_Wireframe){
-            draw_triangle(
-                triangle.points[0],
-                triangle.points[1],
-                triangle.points[2],
-                0xFFFFFFFF
-            );
-        }
-        if (RenderMode_Vertex){
-            draw_rect(triangle.points[0].x, triangle.points[0].y, 6, 6, 0xFFFFFF00);
-            draw_rect(triangle.points[1].x, triangle.points[1].y, 6, 6, 0xFFFFFF00);
-            draw_rect(triangle.points[2].x, triangle.points[2].y, 6, 6, 0xFFFFFF00);
-        }
-        if (RenderMode_Texture){
-            draw_textured_triangle(
-                triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, triangle.tex_coords[0].u, triangle.tex_coords[0].v,
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, triangle.tex_coords[1].u, triangle.tex_coords[1].v,
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, triangle.tex_coords[2].u, triangle.tex_coords[2].v,
-                triangle.texture
-            );
+    // rasterize tiles in parallel when the edge function rasterizer is active
+    if (RasterMode_VisBuffer && RasterMode_Edge){
+        render_visibility(&render_queue);
+    }
+    else if (RasterMode_Tiled && RasterMode_Edge){
+        render_tiles(&render_queue);
+    }
+    else {
+        for (int i = 0; i < num_triangles_to_render; i++){
+            render_triangle(&render_queue, i, getScreenRect());
         }
     }
     render_color_buffer();
@@ -357,6 +289,13 @@ void render(void){
 
 void free_resources(void){
     free_mesh();
+    free_materials();
+    free_geometry();
+    free_scene();
+    free_scene_graph();
+    free_occlusion();
+    free_frame_arena();
+    free_job_system();
     destroy_window();
 }
 
@@ -73,6 +73,16 @@ mat4_t mat4_rotation_z(float angle){
     return m;
 }
 
+mat4_t mat4_transform(vec3_t scale, vec3_t rotation, vec3_t translation){
+    // scale, then rotate around x, y and z, then translate
+    mat4_t m = mat4_scale(scale.x, scale.y, scale.z);
+    m = mat4_mul_mat4(mat4_rotation_x(rotation.x), m);
+    m = mat4_mul_mat4(mat4_rotation_y(rotation.y), m);
+    m = mat4_mul_mat4(mat4_rotation_z(rotation.z), m);
+    m = mat4_mul_mat4(mat4_translation(translation.x, translation.y, translation.z), m);
+    return m;
+}
+
 mat4_t mat4_perspective(float fov, float aspect, float z_near, float z_far){
     mat4_t m = {{{0}}};
 
@@ -119,6 +129,18 @@ mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up){
     return view_matrix;
 }
 
+mat4_t mat4_viewport(float width, float height){
+    mat4_t m = mat4_identity();
+
+    // map normalized device coordinates to pixels, flipping y so it grows downwards
+    m.m[0][0] = width / 2.0;
+    m.m[0][3] = width / 2.0;
+    m.m[1][1] = -height / 2.0;
+    m.m[1][3] = height / 2.0;
+
+    return m;
+}
+
 vec4_t mat4_mul_vec4(mat4_t m, vec4_t v){
     vec4_t result;
 
@@ -140,4 +162,33 @@ mat4_t mat4_mul_mat4(mat4_t a, mat4_t b){
     }
 
     return result;
-}
\ No newline at end of file
+}
+
+float mat4_determinant_3x3(mat4_t m){
+    return m.m[0][0] * (m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1]) -
+           m.m[0][1] * (m.m[1][0] * m.m[2][2] - m.m[1][2] * m.m[2][0]) +
+           m.m[0][2] * (m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0]);
+}
+
+mat4_t mat4_inverse_affine(mat4_t m){
+    float det = mat4_determinant_3x3(m);
+    if (det == 0) return mat4_identity();
+
+    // invert the linear part by its cofactors, then undo the translation with it
+    mat4_t result = mat4_identity();
+    result.m[0][0] = (m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1]) / det;
+    result.m[0][1] = (m.m[0][2] * m.m[2][1] - m.m[0][1] * m.m[2][2]) / det;
+    result.m[0][2] = (m.m[0][1] * m.m[1][2] - m.m[0][2] * m.m[1][1]) / det;
+    result.m[1][0] = (m.m[1][2] * m.m[2][0] - m.m[1][0] * m.m[2][2]) / det;
+    result.m[1][1] = (m.m[0][0] * m.m[2][2] - m.m[0][2] * m.m[2][0]) / det;
+    result.m[1][2] = (m.m[0][2] * m.m[1][0] - m.m[0][0] * m.m[1][2]) / det;
+    result.m[2][0] = (m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0]) / det;
+    result.m[2][1] = (m.m[0][1] * m.m[2][0] - m.m[0][0] * m.m[2][1]) / det;
+    result.m[2][2] = (m.m[0][0] * m.m[1][1] - m.m[0][1] * m.m[1][0]) / det;
+
+    for (int i = 0; i < 3; i++){
+        result.m[i][3] = -(result.m[i][0] * m.m[0][3] + result.m[i][1] * m.m[1][3] + result.m[i][2] * m.m[2][3]);
+    }
+
+    return result;
+}
@@ -13,12 +13,16 @@ mat4_t mat4_translation(float tx, float ty, float tz);
 mat4_t mat4_rotation_x(float angle);
 mat4_t mat4_rotation_y(float angle);
 mat4_t mat4_rotation_z(float angle);
+mat4_t mat4_transform(vec3_t scale, vec3_t rotation, vec3_t translation);
 
 mat4_t mat4_perspective(float fov, float aspect, float z_near, float z_far);
 vec4_t mat4_project(mat4_t proj_mat, vec4_t v);
 mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up);
+mat4_t mat4_viewport(float width, float height);
 
 vec4_t mat4_mul_vec4(mat4_t m, vec4_t v);
 mat4_t mat4_mul_mat4(mat4_t a, mat4_t b);
+float mat4_determinant_3x3(mat4_t m);
+mat4_t mat4_inverse_affine(mat4_t m);
 
 #endif //MATRIX_H
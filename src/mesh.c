@@ -1,84 +1,159 @@
 #include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "mesh.h"
 #include "array.h"
 #include "texture.h"
+#include "clipping.h"
+#include "lod.h"
+#include "obj.h"
+#include "vcache.h"
+#include "display.h"
 
-#define MAX_MESHES 10
-
-static mesh_t meshes[MAX_MESHES];
-static int num_meshes = 0;
+// dynamic array of every mesh instance, the scene indexes into it
+static mesh_t *meshes = NULL;
+// loaded resources, allocated one by one so instances can point at them while the array grows
+static mesh_resource_t **resources = NULL;
 
 int getNumMeshes(void){
-    return num_meshes;
+    return array_size(meshes);
 }
 
 mesh_t *getMesh(int index){
-    if(index < 0 || index >= num_meshes) return NULL;
+    if(index < 0 || index >= array_size(meshes)) return NULL;
     return &meshes[index];
 }
 
-void load_obj_file(mesh_t *mesh, const char *filename) {
-    FILE *file;
-    char line[1024];
-    tex2_t *texcoords = NULL;
+int getNumMeshResources(void){
+    return array_size(resources);
+}
 
-    file = fopen(filename, "r");
+void setMeshOccluder(int index, bool occluder){
+    mesh_t *mesh = getMesh(index);
+    if (mesh != NULL) mesh->is_occluder = occluder;
+}
 
-    if (file == NULL) {
-        perror("Error opening file");
-        return;
+static uint16_t quantize(float value, float offset, float scale){
+    if (scale == 0) return 0;
+    float steps = (value - offset) / scale + 0.5;
+    return steps >= 65535 ? 65535 : (steps <= 0 ? 0 : (uint16_t) steps);
+}
+
+// packs the vertex buffer into 16 bit steps across the position and texcoord bounds, once the vertex order is final
+static void quantize_vertices(mesh_resource_t *resource){
+    int num_vertices = array_size(resource->vertices);
+    if (num_vertices <= 0) return;
+
+    tex2_t uv_min = resource->vertices[0].uv;
+    tex2_t uv_max = resource->vertices[0].uv;
+    for (int i = 1; i < num_vertices; i++){
+        tex2_t uv = resource->vertices[i].uv;
+        if (uv.u < uv_min.u) uv_min.u = uv.u;
+        if (uv.v < uv_min.v) uv_min.v = uv.v;
+        if (uv.u > uv_max.u) uv_max.u = uv.u;
+        if (uv.v > uv_max.v) uv_max.v = uv.v;
     }
+    vec3_t offset = resource->bounds_min;
+    vec3_t scale = vec3_mul(vec3_sub(resource->bounds_max, resource->bounds_min), 1.0 / 65535);
+    resource->uv_offset = uv_min;
+    resource->uv_scale = (tex2_t) { (uv_max.u - uv_min.u) / 65535, (uv_max.v - uv_min.v) / 65535 };
+    resource->dequantize_matrix = mat4_mul_mat4(mat4_translation(offset.x, offset.y, offset.z), mat4_scale(scale.x, scale.y, scale.z));
 
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == 'v') {
-            float x, y, z;
-            float u, v;
-            if (line[1] == ' ') {
-                sscanf(line, "v %f %f %f", &x, &y, &z);
-                vec3_t mesh_vertex = {x, y, z};
-                array_push(mesh->vertices, mesh_vertex);
-            }
-            else if (line[1] == 't') {
-                sscanf(line, "vt %f %f", &u, &v);
-                tex2_t texcoord = {u, v};
-                array_push(texcoords, texcoord);
-            }
-        }
-        else if (line[0] == 'f') {
-            int v1, v2, v3;
-            int vt1, vt2, vt3;
-            int vn1, vn2, vn3;
-            if (line[1] == ' ') {
-                sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                       &v1, &vt1, &vn1,
-                       &v2, &vt2, &vn2,
-                       &v3, &vt3, &vn3
-                );
-                face_t mesh_face = {
-                    .a = v1,
-                    .b = v2,
-                    .c = v3,
-                    .a_uv = texcoords[vt1 - 1],
-                    .b_uv = texcoords[vt2 - 1],
-                    .c_uv = texcoords[vt3 - 1],
-                    .color = 0xFFFFFFFF
-                };
-                array_push(mesh->faces, mesh_face);
-            }
-        }
+    resource->packed_vertices = (packed_vertex_t*) malloc(num_vertices * sizeof(packed_vertex_t));
+    for (int i = 0; i < num_vertices; i++){
+        mesh_vertex_t *vertex = &resource->vertices[i];
+        packed_vertex_t *packed = &resource->packed_vertices[i];
+        packed->position[0] = quantize(vertex->position.x, offset.x, scale.x);
+        packed->position[1] = quantize(vertex->position.y, offset.y, scale.y);
+        packed->position[2] = quantize(vertex->position.z, offset.z, scale.z);
+        packed->uv[0] = quantize(vertex->uv.u, resource->uv_offset.u, resource->uv_scale.u);
+        packed->uv[1] = quantize(vertex->uv.v, resource->uv_offset.v, resource->uv_scale.v);
     }
-    array_free(texcoords);
-    fclose(file);
 }
 
-void load_png_texture_data(mesh_t *mesh, const char *file_name){
+void load_png_texture_data(mesh_resource_t *resource, const char *file_name){
     upng_t *texture_data = upng_new_from_file(file_name);
     if (texture_data != NULL){
         upng_decode(texture_data);
         if (upng_get_error(texture_data) == UPNG_EOK){
-            mesh->texture = texture_data;
+            resource->texture = texture_data;
+        }
+    }
+}
+
+static char *copy_string(const char *string){
+    char *copy = (char*) malloc(strlen(string) + 1);
+    strcpy(copy, string);
+    return copy;
+}
+
+static int find_mesh_resource(const char *obj_file_name, const char *texture_file_name){
+    for (int i = 0; i < array_size(resources); i++){
+        if (strcmp(resources[i]->obj_file_name, obj_file_name) == 0 && strcmp(resources[i]->texture_file_name, texture_file_name) == 0){
+            return i;
         }
     }
+    return -1;
+}
+
+int load_mesh_resource(const char *obj_file_name, const char *texture_file_name){
+    // a pair that is already loaded only gets more instances
+    int loaded = find_mesh_resource(obj_file_name, texture_file_name);
+    if (loaded >= 0) return loaded;
+
+    mesh_resource_t *resource = (mesh_resource_t*) calloc(1, sizeof(mesh_resource_t));
+    resource->id = array_size(resources);
+    resource->obj_file_name = copy_string(obj_file_name);
+    resource->texture_file_name = copy_string(texture_file_name);
+    array_push(resources, resource);
+
+    load_obj_file(resource, obj_file_name);
+    load_png_texture_data(resource, texture_file_name);
+    compute_mesh_bounds(resource);
+    // simplified levels share the vertices of the full mesh
+    build_mesh_lods(resource);
+    float file_acmr = compute_acmr(resource->faces, array_size(resource->vertices));
+    // clusters reorder the faces of each level into contiguous ranges, seeded in cache friendly order
+    for (int i = 0; i < resource->num_lods; i++) {
+        if (GeometryMode_VertexCache) optimize_vertex_cache(resource->lod_faces[i], array_size(resource->vertices));
+        build_meshlets(&resource->lod_meshlets[i], resource->lod_faces[i], resource->vertices);
+    }
+    if (GeometryMode_VertexCache) optimize_vertex_fetch(resource);
+    printf("%s: %d vertices, %d faces, ACMR %.3f -> %.3f\n", obj_file_name, array_size(resource->vertices),
+        array_size(resource->faces), file_acmr, compute_acmr(resource->faces, array_size(resource->vertices)));
+    // nothing reads the float vertices after loading, the packed ones replace them
+    if (GeometryMode_Quantized){
+        quantize_vertices(resource);
+        array_free(resource->vertices);
+        resource->vertices = NULL;
+    }
+    // every resource owns its texture and with it a material
+    resource->material = add_material(resource->texture);
+    return resource->id;
+}
+
+int add_mesh_instances(int resource_index, const instance_transform_t *transforms, int count){
+    int first = array_size(meshes);
+    if (resource_index < 0 || resource_index >= array_size(resources)) return -1;
+
+    for (int i = 0; i < count; i++){
+        // the instance only carries its transform and what is derived from it
+        mesh_t instance = { 0 };
+        instance.resource = resources[resource_index];
+        instance.scale = transforms[i].scale;
+        instance.rotation = transforms[i].rotation;
+        instance.translation = transforms[i].translation;
+        instance.node = -1;
+        instance.matrices_valid = false;
+        array_push(meshes, instance);
+    }
+    return first;
+}
+
+int add_mesh_instance(int resource_index, vec3_t scale, vec3_t rotation, vec3_t translation){
+    instance_transform_t transform = { scale, rotation, translation };
+    return add_mesh_instances(resource_index, &transform, 1);
 }
 
 void load_mesh(
@@ -88,19 +163,161 @@ void load_mesh(
         vec3_t rotation,
         vec3_t translation
 ){
-    load_obj_file(&meshes[num_meshes], obj_file_name);
-    load_png_texture_data(&meshes[num_meshes], texture_file_name);
-    meshes[num_meshes].scale = scale;
-    meshes[num_meshes].rotation = rotation;
-    meshes[num_meshes].translation = translation;
+    add_mesh_instance(load_mesh_resource(obj_file_name, texture_file_name), scale, rotation, translation);
+}
+
+void compute_face_planes(face_t *faces, mesh_vertex_t *vertices){
+    for (int i = 0; i < array_size(faces); i++){
+        face_t *face = &faces[i];
+        vec3_t a = vertices[face->a].position;
+        vec3_t normal = vec3_cross(vec3_sub(vertices[face->b].position, a), vec3_sub(vertices[face->c].position, a));
+        // degenerate faces keep a zero normal, they are never culled and never lit
+        if (vec3_length(normal) > 0) vec3_normalize(&normal);
+        face->normal = normal;
+        face->plane_offset = vec3_dot(normal, a);
+    }
+}
 
-    num_meshes++;
+void compute_mesh_bounds(mesh_resource_t *resource){
+    int num_vertices = array_size(resource->vertices);
+    if (num_vertices == 0){
+        resource->bounds_min = resource->bounds_max = resource->bounds_center = vec3_new(0, 0, 0);
+        resource->bounds_radius = 0;
+        return;
+    }
+
+    vec3_t min = resource->vertices[0].position;
+    vec3_t max = resource->vertices[0].position;
+    for (int i = 1; i < num_vertices; i++){
+        vec3_t v = resource->vertices[i].position;
+        if (v.x < min.x) min.x = v.x;
+        if (v.y < min.y) min.y = v.y;
+        if (v.z < min.z) min.z = v.z;
+        if (v.x > max.x) max.x = v.x;
+        if (v.y > max.y) max.y = v.y;
+        if (v.z > max.z) max.z = v.z;
+    }
+
+    // sphere around the box center, tightened to the farthest vertex
+    vec3_t center = vec3_mul(vec3_add(min, max), 0.5);
+    float radius = 0;
+    for (int i = 0; i < num_vertices; i++){
+        float distance = vec3_length(vec3_sub(resource->vertices[i].position, center));
+        if (distance > radius) radius = distance;
+    }
+
+    resource->bounds_min = min;
+    resource->bounds_max = max;
+    resource->bounds_center = center;
+    resource->bounds_radius = radius;
+}
+
+int classify_mesh(mesh_t *mesh){
+    // the sphere is cheap and settles most meshes
+    vec4_t center = mat4_mul_vec4(mesh->model_view_matrix, vec4_from_vec3(mesh->resource->bounds_center));
+    int result = classify_sphere(vec3_from_vec4(center), mesh->resource->bounds_radius * mesh->max_scale);
+    if (result != FRUSTUM_INTERSECT) return result;
+
+    // otherwise test the box corners in clip space
+    int and_code = -1;
+    int or_code = 0;
+    for (int i = 0; i < 8; i++){
+        vec4_t corner = {
+            (i & 1) ? mesh->resource->bounds_max.x : mesh->resource->bounds_min.x,
+            (i & 2) ? mesh->resource->bounds_max.y : mesh->resource->bounds_min.y,
+            (i & 4) ? mesh->resource->bounds_max.z : mesh->resource->bounds_min.z,
+            1
+        };
+        int code = compute_clip_outcode(mat4_mul_vec4(mesh->mvp_matrix, corner));
+        and_code &= code;
+        or_code |= code;
+    }
+
+    if (and_code != 0) return FRUSTUM_OUTSIDE;
+    // inside the guard band no face needs clipping, the rasterizer scissors to the screen
+    if ((or_code & ~SIDE_PLANES_OUTCODE) == 0) return FRUSTUM_INSIDE;
+    return FRUSTUM_INTERSECT;
+}
+
+static bool vec3_equal(vec3_t a, vec3_t b){
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static float max_axis_scale(mat4_t m){
+    float scale = 0;
+    for (int axis = 0; axis < 3; axis++){
+        float length = sqrt(m.m[0][axis] * m.m[0][axis] + m.m[1][axis] * m.m[1][axis] + m.m[2][axis] * m.m[2][axis]);
+        if (length > scale) scale = length;
+    }
+    return scale;
+}
+
+void update_mesh_matrices(mesh_t *mesh, const frame_constants_t *frame){
+    bool model_changed;
+    if (mesh->node >= 0){
+        // the scene graph wrote the model matrix
+        model_changed = !mesh->matrices_valid || mesh->node_moved;
+        if (model_changed) mesh->max_scale = max_axis_scale(mesh->model_matrix);
+        mesh->node_moved = false;
+    }
+    else {
+        model_changed = !mesh->matrices_valid ||
+            !vec3_equal(mesh->scale, mesh->cached_scale) ||
+            !vec3_equal(mesh->rotation, mesh->cached_rotation) ||
+            !vec3_equal(mesh->translation, mesh->cached_translation);
+
+        if (model_changed){
+            mesh->model_matrix = mat4_transform(mesh->scale, mesh->rotation, mesh->translation);
+            mesh->cached_scale = mesh->scale;
+            mesh->cached_rotation = mesh->rotation;
+            mesh->cached_translation = mesh->translation;
+
+            mesh->max_scale = fabs(mesh->scale.x);
+            if (fabs(mesh->scale.y) > mesh->max_scale) mesh->max_scale = fabs(mesh->scale.y);
+            if (fabs(mesh->scale.z) > mesh->max_scale) mesh->max_scale = fabs(mesh->scale.z);
+        }
+    }
+
+    if (model_changed || mesh->cached_camera_version != frame->camera_version){
+        mesh->model_view_matrix = mat4_mul_mat4(frame->view_matrix, mesh->model_matrix);
+        mesh->mvp_matrix = mat4_mul_mat4(frame->proj_matrix, mesh->model_view_matrix);
+        mesh->packed_mvp_matrix = mat4_mul_mat4(mesh->mvp_matrix, mesh->resource->dequantize_matrix);
+        mesh->cached_camera_version = frame->camera_version;
+
+        // the camera sits at the view space origin, the light direction is given in view space
+        mat4_t inverse_model_view = mat4_inverse_affine(mesh->model_view_matrix);
+        mesh->object_camera_position = vec3_new(inverse_model_view.m[0][3], inverse_model_view.m[1][3], inverse_model_view.m[2][3]);
+        vec4_t light = { frame->light_direction.x, frame->light_direction.y, frame->light_direction.z, 0 };
+        mesh->object_light_direction = vec3_from_vec4(mat4_mul_vec4(inverse_model_view, light));
+        if (vec3_length(mesh->object_light_direction) > 0) vec3_normalize(&mesh->object_light_direction);
+        mesh->winding = mat4_determinant_3x3(mesh->model_view_matrix) < 0 ? -1 : 1;
+    }
+
+    mesh->matrices_valid = true;
+}
+
+bool is_face_backfacing(const mesh_t *mesh, const face_t *face){
+    // the camera lies behind the plane of the face
+    return mesh->winding * (vec3_dot(face->normal, mesh->object_camera_position) - face->plane_offset) < 0;
 }
 
 void free_mesh(void){
-    for (int i = 0; i < num_meshes; i++){
-        upng_free(meshes[i].texture);
-        array_free(meshes[i].vertices);
-        array_free(meshes[i].faces);
+    for (int i = 0; i < array_size(resources); i++){
+        mesh_resource_t *resource = resources[i];
+        for (int j = 0; j < MAX_LODS; j++){
+            free_meshlets(&resource->lod_meshlets[j]);
+        }
+        free_mesh_lods(resource);
+        upng_free(resource->texture);
+        array_free(resource->vertices);
+        free(resource->packed_vertices);
+        array_free(resource->faces);
+        free(resource->obj_file_name);
+        free(resource->texture_file_name);
+        free(resource);
     }
+    array_free(resources);
+    array_free(meshes);
+    resources = NULL;
+    meshes = NULL;
 }
@@ -1,25 +1,106 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <stdbool.h>
 #include "vector.h"
+#include "matrix.h"
+#include "frame.h"
 #include "triangle.h"
 #include "upng.h"
+#include "meshlet.h"
 
+// levels of detail per mesh including the full resolution one
+#define MAX_LODS 5
+
+// object space data of one loaded obj file, shared by every instance drawn with it
 typedef struct{
-    vec3_t *vertices;
+    // unique position/texcoord/normal combinations, faces index into it.
+    // freed once loading is done when the resource is stored quantized
+    mesh_vertex_t *vertices;
+    // quantized positions and texcoords of the same vertices, NULL unless the resource is stored quantized
+    packed_vertex_t *packed_vertices;
+    // maps packed positions back to object space, texcoords decode as uv_offset + uv * uv_scale
+    mat4_t dequantize_matrix;
+    tex2_t uv_offset;
+    tex2_t uv_scale;
     face_t *faces;
+    // simplified face lists over the same vertices, lod_faces[0] is faces
+    face_t *lod_faces[MAX_LODS];
+    // clusters of every level, built after the faces of the level are final
+    meshlet_set_t lod_meshlets[MAX_LODS];
+    int num_lods;
     upng_t *texture;
+    // index of the texture in the material table
+    uint16_t material;
+    // object space bounds computed at load time
+    vec3_t bounds_min;
+    vec3_t bounds_max;
+    vec3_t bounds_center;
+    float bounds_radius;
+    // load order, instances are drawn grouped by it
+    int id;
+    // files the resource was loaded from, loading the same pair again returns this resource
+    char *obj_file_name;
+    char *texture_file_name;
+} mesh_resource_t;
+
+typedef struct {
+    vec3_t scale;
+    vec3_t rotation;
+    vec3_t translation;
+} instance_transform_t;
+
+// one placement of a resource in the scene, everything that depends on the transform lives here
+typedef struct{
+    mesh_resource_t *resource;
+    // level of detail picked for this instance
+    int lod;
+    // rasterized into the occlusion buffer to hide the meshes behind it
+    bool is_occluder;
+    // transform of a mesh placed on its own, ignored once a scene graph node places it
     vec3_t rotation;
     vec3_t scale;
     vec3_t translation;
+    // scene graph node writing the model matrix, -1 when the transform above builds it
+    int node;
+    // the node wrote a new model matrix since the matrices were last updated
+    bool node_moved;
+    // largest axis scale of the model matrix, bounding spheres grow by it
+    float max_scale;
+    // frustum test result of the current frame
+    int frustum_result;
+    // matrices cached from the transform and camera they were built with
+    mat4_t model_matrix;
+    mat4_t model_view_matrix;
+    mat4_t mvp_matrix;
+    // mvp_matrix taking packed positions, the decoding folded in
+    mat4_t packed_mvp_matrix;
+    vec3_t cached_scale;
+    vec3_t cached_rotation;
+    vec3_t cached_translation;
+    int cached_camera_version;
+    bool matrices_valid;
+    // camera and light moved into object space, faces are culled and lit without transforming them
+    vec3_t object_camera_position;
+    vec3_t object_light_direction;
+    // -1 when the model view matrix mirrors the faces, turning their winding around
+    float winding;
 } mesh_t;
 
 int getNumMeshes(void);
 mesh_t *getMesh(int index);
+int getNumMeshResources(void);
+void setMeshOccluder(int index, bool occluder);
 
-void load_obj_file(mesh_t *mesh, const char *filename);
-void load_png_texture_data(mesh_t *mesh, const char *file_name);
+void load_png_texture_data(mesh_resource_t *resource, const char *file_name);
 
+// loads the geometry and texture once per file pair, returns the resource index instances are added with
+int load_mesh_resource(const char *obj_file_name, const char *texture_file_name);
+// places the resource in the scene, returns the mesh index of the instance
+int add_mesh_instance(int resource_index, vec3_t scale, vec3_t rotation, vec3_t translation);
+// places count instances, returns the mesh index of the first one
+int add_mesh_instances(int resource_index, const instance_transform_t *transforms, int count);
+// a resource with a single instance
 void load_mesh(
     const char *obj_file_name,
     const char *texture_file_name,
@@ -28,6 +109,12 @@ void load_mesh(
     vec3_t translation
 );
 
+void compute_face_planes(face_t *faces, mesh_vertex_t *vertices);
+void compute_mesh_bounds(mesh_resource_t *resource);
+int classify_mesh(mesh_t *mesh);
+void update_mesh_matrices(mesh_t *mesh, const frame_constants_t *frame);
+bool is_face_backfacing(const mesh_t *mesh, const face_t *face);
+
 void free_mesh(void);
 
 #endif //MESH_H
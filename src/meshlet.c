@@ -0,0 +1,196 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "meshlet.h"
+#include "array.h"
+#include "hash.h"
+
+static int face_corner(face_t *face, int corner){
+    return (int) (corner == 0 ? face->a : (corner == 1 ? face->b : face->c));
+}
+
+// cluster vertices the face would add
+static int count_new_vertices(face_t *face, const int *slots){
+    int a = (int) face->a, b = (int) face->b, c = (int) face->c;
+    int count = slots[a] < 0;
+    if (slots[b] < 0 && b != a) count++;
+    if (slots[c] < 0 && c != a && c != b) count++;
+    return count;
+}
+
+static void compute_meshlet_bounds(meshlet_t *meshlet, const meshlet_set_t *set, face_t *faces, mesh_vertex_t *vertices){
+    // sphere around the box center, tightened to the farthest vertex
+    const int *indices = &set->vertices[meshlet->first_vertex];
+    vec3_t min = vertices[indices[0]].position;
+    vec3_t max = vertices[indices[0]].position;
+    for (int i = 1; i < meshlet->num_vertices; i++){
+        vec3_t v = vertices[indices[i]].position;
+        if (v.x < min.x) min.x = v.x;
+        if (v.y < min.y) min.y = v.y;
+        if (v.z < min.z) min.z = v.z;
+        if (v.x > max.x) max.x = v.x;
+        if (v.y > max.y) max.y = v.y;
+        if (v.z > max.z) max.z = v.z;
+    }
+    meshlet->center = vec3_mul(vec3_add(min, max), 0.5);
+    meshlet->radius = 0;
+    for (int i = 0; i < meshlet->num_vertices; i++){
+        float distance = vec3_length(vec3_sub(vertices[indices[i]].position, meshlet->center));
+        if (distance > meshlet->radius) meshlet->radius = distance;
+    }
+
+    // the cone axis is the mean face normal, its angle reaches the normal farthest from it
+    vec3_t axis = vec3_new(0, 0, 0);
+    for (int i = meshlet->first_face; i < meshlet->first_face + meshlet->num_faces; i++){
+        axis = vec3_add(axis, faces[i].normal);
+    }
+
+    meshlet->cone_cos = -1;
+    if (vec3_length(axis) > 0){
+        vec3_normalize(&axis);
+        meshlet->cone_cos = 1;
+        for (int i = meshlet->first_face; i < meshlet->first_face + meshlet->num_faces; i++){
+            // degenerate faces cover no pixels and do not bend the cone
+            if (vec3_length(faces[i].normal) == 0) continue;
+            float cos_angle = vec3_dot(faces[i].normal, axis);
+            if (cos_angle < meshlet->cone_cos) meshlet->cone_cos = cos_angle;
+        }
+    }
+    meshlet->cone_axis = axis;
+    meshlet->cone_sin = sqrt(fmax(0, 1 - meshlet->cone_cos * meshlet->cone_cos));
+}
+
+void build_meshlets(meshlet_set_t *set, face_t *faces, mesh_vertex_t *vertices){
+    free_meshlets(set);
+    int num_faces = array_size(faces);
+    int num_vertices = array_size(vertices);
+    if (num_faces <= 0) return;
+
+    // texture seams and hard edges split vertices, neighbours are found over the welded positions so
+    // clusters grow across them
+    int *vertex_positions = (int*) malloc(num_vertices * sizeof(int));
+    int num_positions = weld_vertex_positions(vertices, num_vertices, vertex_positions);
+
+    // faces around every position, packed by position
+    int *position_offsets = (int*) calloc(num_positions + 1, sizeof(int));
+    int *position_faces = (int*) malloc(3 * num_faces * sizeof(int));
+    int *fill = (int*) malloc(num_positions * sizeof(int));
+    for (int i = 0; i < num_faces; i++){
+        for (int corner = 0; corner < 3; corner++) position_offsets[vertex_positions[face_corner(&faces[i], corner)] + 1]++;
+    }
+    for (int i = 0; i < num_positions; i++){
+        position_offsets[i + 1] += position_offsets[i];
+        fill[i] = position_offsets[i];
+    }
+    for (int i = 0; i < num_faces; i++){
+        for (int corner = 0; corner < 3; corner++) position_faces[fill[vertex_positions[face_corner(&faces[i], corner)]]++] = i;
+    }
+    // cluster that last queued the faces around every position
+    int *position_cluster = (int*) malloc(num_positions * sizeof(int));
+    for (int i = 0; i < num_positions; i++) position_cluster[i] = -1;
+
+    bool *assigned = (bool*) calloc(num_faces, sizeof(bool));
+    // cluster vertex of every mesh vertex in the cluster being built, -1 elsewhere
+    int *slots = (int*) malloc(num_vertices * sizeof(int));
+    for (int i = 0; i < num_vertices; i++) slots[i] = -1;
+    face_t *ordered = (face_t*) malloc(num_faces * sizeof(face_t));
+    int *candidates = NULL;
+
+    int num_ordered = 0;
+    int seed = 0;
+    while (num_ordered < num_faces){
+        while (assigned[seed]) seed++;
+
+        meshlet_t meshlet = { 0 };
+        meshlet.first_face = num_ordered;
+        meshlet.first_vertex = array_size(set->vertices);
+        array_clear(candidates);
+
+        int face = seed;
+        while (face >= 0){
+            assigned[face] = true;
+            ordered[num_ordered++] = faces[face];
+            meshlet.num_faces++;
+
+            for (int corner = 0; corner < 3; corner++){
+                int vertex = face_corner(&faces[face], corner);
+                if (slots[vertex] < 0){
+                    slots[vertex] = meshlet.num_vertices++;
+                    array_push(set->vertices, vertex);
+                }
+                // faces touching a new position are the ones the cluster can grow into
+                int position = vertex_positions[vertex];
+                if (position_cluster[position] != array_size(set->meshlets)){
+                    position_cluster[position] = array_size(set->meshlets);
+                    for (int k = position_offsets[position]; k < position_offsets[position + 1]; k++){
+                        if (!assigned[position_faces[k]]) array_push(candidates, position_faces[k]);
+                    }
+                }
+                uint8_t index = (uint8_t) slots[vertex];
+                array_push(set->indices, index);
+            }
+
+            if (meshlet.num_faces == MESHLET_MAX_TRIANGLES) break;
+
+            // grow by the neighbour adding the fewest vertices so the cluster stays compact,
+            // dropping the candidates taken in the meantime
+            face = -1;
+            int best = 4;
+            int num_candidates = 0;
+            for (int i = 0; i < array_size(candidates); i++){
+                int candidate = candidates[i];
+                if (assigned[candidate]) continue;
+                candidates[num_candidates++] = candidate;
+                int cost = count_new_vertices(&faces[candidate], slots);
+                if (meshlet.num_vertices + cost > MESHLET_MAX_VERTICES || cost >= best) continue;
+                best = cost;
+                face = candidate;
+            }
+            array_truncate(candidates, num_candidates);
+        }
+
+        for (int i = 0; i < meshlet.num_vertices; i++){
+            slots[set->vertices[meshlet.first_vertex + i]] = -1;
+        }
+        compute_meshlet_bounds(&meshlet, set, ordered, vertices);
+        array_push(set->meshlets, meshlet);
+    }
+
+    // faces follow the clusters so every cluster is one range
+    memcpy(faces, ordered, num_faces * sizeof(face_t));
+
+    array_free(candidates);
+    free(ordered);
+    free(slots);
+    free(assigned);
+    free(position_cluster);
+    free(fill);
+    free(position_faces);
+    free(position_offsets);
+    free(vertex_positions);
+}
+
+bool is_meshlet_backfacing(const meshlet_t *meshlet, vec3_t camera_position, float winding){
+    // the normals spread too far for all of them to face away at once
+    if (meshlet->cone_cos <= 0) return false;
+    vec3_t offset = vec3_sub(meshlet->center, camera_position);
+    float distance = vec3_length(offset);
+    if (distance <= meshlet->radius) return false;
+
+    // everything is in object space, where the plane test does not depend on the transform.
+    // no normal is farther than the cone angle from the axis, so the sphere seen along the worst
+    // normal has to stay behind every face plane
+    float cos_angle = winding * vec3_dot(offset, meshlet->cone_axis) / distance;
+    float sin_angle = sqrt(fmax(0, 1 - cos_angle * cos_angle));
+    float cos_worst = meshlet->cone_cos * cos_angle - meshlet->cone_sin * sin_angle;
+    return distance * cos_worst > meshlet->radius;
+}
+
+void free_meshlets(meshlet_set_t *set){
+    array_free(set->meshlets);
+    array_free(set->vertices);
+    array_free(set->indices);
+    set->meshlets = NULL;
+    set->vertices = NULL;
+    set->indices = NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vector.h"
+#include "triangle.h"
+
+// limits of one cluster, small enough to index its vertices with a byte
+#define MESHLET_MAX_TRIANGLES 64
+#define MESHLET_MAX_VERTICES 64
+
+typedef struct {
+    // faces of the level this cluster covers, their corners index the cluster vertices
+    int first_face;
+    int num_faces;
+    int first_vertex;
+    int num_vertices;
+    // object space bounding sphere
+    vec3_t center;
+    float radius;
+    // every face normal lies within the cone around the axis, cone_cos <= 0 when they spread too far to cull
+    vec3_t cone_axis;
+    float cone_cos;
+    float cone_sin;
+} meshlet_t;
+
+typedef struct {
+    meshlet_t *meshlets;
+    // mesh vertex index of every cluster vertex
+    int *vertices;
+    // three cluster vertex indices per face
+    uint8_t *indices;
+} meshlet_set_t;
+
+void build_meshlets(meshlet_set_t *set, face_t *faces, mesh_vertex_t *vertices);
+bool is_meshlet_backfacing(const meshlet_t *meshlet, vec3_t camera_position, float winding);
+void free_meshlets(meshlet_set_t *set);
+
+#endif //MESHLET_H
@@ -0,0 +1,393 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "obj.h"
+#include "array.h"
+#include "hash.h"
+
+// whole file mapped read only, the parser walks it in place
+typedef struct {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} mapped_file_t;
+
+enum {
+    OBJ_LINE_OTHER,
+    OBJ_LINE_POSITION,
+    OBJ_LINE_TEXCOORD,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE
+};
+
+typedef struct {
+    int positions;
+    int texcoords;
+    int normals;
+    int faces;
+} obj_counts_t;
+
+#define MAX_MANTISSA 1000000000000000000ULL
+
+// powers of ten a double holds exactly
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool map_file(mapped_file_t *file, const char *filename){
+    file->data = NULL;
+    file->size = 0;
+#ifdef _WIN32
+    file->mapping = NULL;
+    file->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size)){
+        CloseHandle(file->file);
+        return false;
+    }
+    file->size = (size_t) size.QuadPart;
+    // an empty file cannot be mapped and has nothing to parse
+    if (file->size == 0) return true;
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping == NULL){
+        CloseHandle(file->file);
+        return false;
+    }
+    file->data = (const char*) MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL){
+        CloseHandle(file->mapping);
+        CloseHandle(file->file);
+        return false;
+    }
+#else
+    int descriptor = open(filename, O_RDONLY);
+    if (descriptor < 0) return false;
+    struct stat info;
+    if (fstat(descriptor, &info) != 0){
+        close(descriptor);
+        return false;
+    }
+    file->size = (size_t) info.st_size;
+    if (file->size > 0){
+        void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED){
+            close(descriptor);
+            return false;
+        }
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        file->data = (const char*) data;
+    }
+    // the mapping stays valid without the descriptor
+    close(descriptor);
+#endif
+    return true;
+}
+
+static void unmap_file(mapped_file_t *file){
+#ifdef _WIN32
+    if (file->data != NULL) UnmapViewOfFile(file->data);
+    if (file->mapping != NULL) CloseHandle(file->mapping);
+    CloseHandle(file->file);
+#else
+    if (file->data != NULL) munmap((void*) file->data, file->size);
+#endif
+    file->data = NULL;
+    file->size = 0;
+}
+
+static bool is_blank(char c){
+    return c == ' ' || c == '\t';
+}
+
+static bool is_line_end(char c){
+    return c == '\n' || c == '\r';
+}
+
+static const char *skip_blanks(const char *p, const char *end){
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+static const char *skip_line(const char *p, const char *end){
+    const char *newline = (const char*) memchr(p, '\n', end - p);
+    return newline != NULL ? newline + 1 : end;
+}
+
+// p points at the first non blank character of a line
+static int classify_line(const char *p, const char *end){
+    if (end - p < 2) return OBJ_LINE_OTHER;
+    if (p[0] == 'v'){
+        if (is_blank(p[1])) return OBJ_LINE_POSITION;
+        if (end - p >= 3 && is_blank(p[2])){
+            if (p[1] == 't') return OBJ_LINE_TEXCOORD;
+            if (p[1] == 'n') return OBJ_LINE_NORMAL;
+        }
+    }
+    else if (p[0] == 'f' && is_blank(p[1])){
+        return OBJ_LINE_FACE;
+    }
+    return OBJ_LINE_OTHER;
+}
+
+static const char *parse_int(const char *p, const char *end, int *value){
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+    int result = 0;
+    while (p < end && *p >= '0' && *p <= '9'){
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    *value = negative ? -result : result;
+    return p;
+}
+
+static const char *parse_float(const char *p, const char *end, float *value){
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+
+    // up to 19 significant digits are collected exactly, later ones only move the decimal point.
+    // below MAX_MANTISSA the mantissa has fewer than 19 digits and takes one more
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9'){
+        if (mantissa < MAX_MANTISSA) mantissa = mantissa * 10 + (*p - '0');
+        else exponent++;
+        p++;
+    }
+    if (p < end && *p == '.'){
+        p++;
+        while (p < end && *p >= '0' && *p <= '9'){
+            if (mantissa < MAX_MANTISSA){
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')){
+        int exponent_part;
+        p = parse_int(p + 1, end, &exponent_part);
+        exponent += exponent_part;
+    }
+
+    double result = (double) mantissa;
+    if (exponent < 0){
+        result = -exponent <= 22 ? result / powers_of_ten[-exponent] : result / pow(10, -exponent);
+    }
+    else if (exponent > 0){
+        result = exponent <= 22 ? result * powers_of_ten[exponent] : result * pow(10, exponent);
+    }
+    *value = (float) (negative ? -result : result);
+    return p;
+}
+
+// parses up to count numbers of the line, missing ones stay zero
+static const char *parse_floats(const char *p, const char *end, float *values, int count){
+    for (int i = 0; i < count; i++){
+        values[i] = 0;
+        p = skip_blanks(p, end);
+        if (p >= end || is_line_end(*p)) continue;
+        p = parse_float(p, end, &values[i]);
+    }
+    return p;
+}
+
+// one v, v/vt, v//vn or v/vt/vn token, absent indices are zero
+static const char *parse_corner(const char *p, const char *end, int index[3]){
+    index[0] = index[1] = index[2] = 0;
+    p = parse_int(p, end, &index[0]);
+    if (p < end && *p == '/'){
+        p++;
+        if (p < end && *p != '/') p = parse_int(p, end, &index[1]);
+        if (p < end && *p == '/') p = parse_int(p + 1, end, &index[2]);
+    }
+    // whatever else the token holds is not understood
+    while (p < end && !is_blank(*p) && !is_line_end(*p)) p++;
+    return p;
+}
+
+// one based index into the count elements read so far, 0 when absent and -1 when out of range
+static int resolve_index(int index, int count){
+    if (index < 0) index += count + 1;
+    else if (index == 0) return 0;
+    return index >= 1 && index <= count ? index : -1;
+}
+
+// counts the lines of each type from their first characters, jumping from line to line with memchr.
+// faces are counted as triangles, the parser makes room for the extra triangles of larger polygons
+static obj_counts_t count_obj_elements(const char *p, const char *end){
+    obj_counts_t counts = { 0 };
+    while (p < end){
+        p = skip_blanks(p, end);
+        switch (classify_line(p, end)){
+            case OBJ_LINE_POSITION: counts.positions++; break;
+            case OBJ_LINE_TEXCOORD: counts.texcoords++; break;
+            case OBJ_LINE_NORMAL: counts.normals++; break;
+            case OBJ_LINE_FACE: counts.faces++; break;
+            default: break;
+        }
+        p = skip_line(p, end);
+    }
+    return counts;
+}
+
+void load_obj_file(mesh_resource_t *resource, const char *filename) {
+    mapped_file_t file;
+    if (!map_file(&file, filename)) {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return;
+    }
+    const char *p = file.data;
+    const char *end = file.data + file.size;
+
+    // a quick pass sizes every buffer up front
+    obj_counts_t counts = count_obj_elements(p, end);
+    vec3_t *positions = (vec3_t*) malloc((counts.positions + 1) * sizeof(vec3_t));
+    tex2_t *texcoords = (tex2_t*) malloc((counts.texcoords + 1) * sizeof(tex2_t));
+    vec3_t *normals = (vec3_t*) malloc((counts.normals + 1) * sizeof(vec3_t));
+    int num_positions = 0, num_texcoords = 0, num_normals = 0;
+    // faces are written in place and the array is cut to what was valid at the end
+    resource->faces = array_hold(resource->faces, counts.faces, sizeof(face_t));
+    int num_faces = 0;
+    resource->vertices = array_hold(resource->vertices, counts.positions, sizeof(mesh_vertex_t));
+    array_clear(resource->vertices);
+
+    // first vertex made from every position and the texcoord and normal it was made with. most
+    // corners repeat it, only the other combinations along seams and hard edges go through the map
+    int *position_vertices = (int*) malloc((counts.positions + 1) * sizeof(int));
+    for (int i = 0; i <= counts.positions; i++) position_vertices[i] = -1;
+    int *vertex_attributes = (int*) malloc(2 * (counts.positions + 1) * sizeof(int));
+    hash_map_t vertex_map;
+    init_hash_map(&vertex_map, 1024);
+    // resolved index triples of the corners of the current face, grown for larger polygons
+    int max_corners = 4;
+    int *corners = (int*) malloc(3 * max_corners * sizeof(int));
+    float values[3];
+
+    while (p < end) {
+        p = skip_blanks(p, end);
+        switch (classify_line(p, end)) {
+            case OBJ_LINE_POSITION:
+                p = parse_floats(p + 1, end, values, 3);
+                positions[num_positions++] = (vec3_t) { values[0], values[1], values[2] };
+                break;
+            case OBJ_LINE_TEXCOORD:
+                p = parse_floats(p + 2, end, values, 2);
+                texcoords[num_texcoords++] = (tex2_t) { values[0], values[1] };
+                break;
+            case OBJ_LINE_NORMAL:
+                p = parse_floats(p + 2, end, values, 3);
+                normals[num_normals++] = (vec3_t) { values[0], values[1], values[2] };
+                break;
+            case OBJ_LINE_FACE: {
+                int num_corners = 0;
+                bool valid = true;
+                const char *q = p + 1;
+                while (true) {
+                    q = skip_blanks(q, end);
+                    if (q >= end || is_line_end(*q) || *q == '#') break;
+                    if (num_corners == max_corners) {
+                        max_corners *= 2;
+                        corners = (int*) realloc(corners, 3 * max_corners * sizeof(int));
+                    }
+                    int index[3];
+                    q = parse_corner(q, end, index);
+                    // negative indices count back from the elements read so far
+                    int v = resolve_index(index[0], num_positions);
+                    int vt = resolve_index(index[1], num_texcoords);
+                    int vn = resolve_index(index[2], num_normals);
+                    if (v <= 0) valid = false;
+                    int *corner = &corners[3 * num_corners++];
+                    corner[0] = v;
+                    corner[1] = vt < 0 ? 0 : vt;
+                    corner[2] = vn < 0 ? 0 : vn;
+                }
+                p = q;
+                if (!valid || num_corners < 3) break;
+                // every face line was counted as one triangle
+                int extra_triangles = num_faces + num_corners - 2 - array_size(resource->faces);
+                if (extra_triangles > 0) resource->faces = array_hold(resource->faces, extra_triangles, sizeof(face_t));
+
+                uint32_t vertex_indices[3];
+                for (int i = 0; i < num_corners; i++) {
+                    int *corner = &corners[3 * i];
+                    // corners repeating a combination share one vertex
+                    int index = position_vertices[corner[0]];
+                    if (index < 0) {
+                        index = array_size(resource->vertices);
+                        position_vertices[corner[0]] = index;
+                        vertex_attributes[2 * corner[0]] = corner[1];
+                        vertex_attributes[2 * corner[0] + 1] = corner[2];
+                    }
+                    else if (vertex_attributes[2 * corner[0]] != corner[1] || vertex_attributes[2 * corner[0] + 1] != corner[2]) {
+                        uint32_t key[3] = { (uint32_t) corner[0], (uint32_t) corner[1], (uint32_t) corner[2] };
+                        index = hash_map_insert(&vertex_map, key, array_size(resource->vertices));
+                    }
+                    if (index == array_size(resource->vertices)) {
+                        mesh_vertex_t vertex = {
+                            .position = positions[corner[0] - 1],
+                            .uv = corner[1] > 0 ? texcoords[corner[1] - 1] : (tex2_t) { 0, 0 },
+                            .normal = corner[2] > 0 ? normals[corner[2] - 1] : (vec3_t) { 0, 0, 0 }
+                        };
+                        array_push(resource->vertices, vertex);
+                    }
+
+                    // polygons become a fan around their first corner
+                    if (i == 0) vertex_indices[0] = (uint32_t) index;
+                    else if (i == 1) vertex_indices[2] = (uint32_t) index;
+                    else {
+                        vertex_indices[1] = vertex_indices[2];
+                        vertex_indices[2] = (uint32_t) index;
+                        face_t mesh_face = {
+                            .a = vertex_indices[0],
+                            .b = vertex_indices[1],
+                            .c = vertex_indices[2],
+                            .color = 0xFFFFFFFF
+                        };
+                        resource->faces[num_faces++] = mesh_face;
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        // the rest of the line is searched from where the parser stopped
+        p = skip_line(p, end);
+    }
+
+    array_truncate(resource->faces, num_faces);
+    free(corners);
+    free_hash_map(&vertex_map);
+    free(vertex_attributes);
+    free(position_vertices);
+    free(positions);
+    free(texcoords);
+    free(normals);
+    unmap_file(&file);
+
+    // normals never change with the transform, so they are found once here
+    compute_face_planes(resource->faces, resource->vertices);
+}
@@ -0,0 +1,11 @@
+#ifndef OBJ_H
+#define OBJ_H
+
+#include "mesh.h"
+
+// reads positions, texcoords, normals and faces of a wavefront obj file into the resource.
+// faces may use v, v/vt, v//vn or v/vt/vn corners with negative indices counting back from the
+// latest element, polygons with more than three corners are split into a fan of triangles
+void load_obj_file(mesh_resource_t *resource, const char *filename);
+
+#endif //OBJ_H
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include "occlusion.h"
+#include "array.h"
+#include "display.h"
+#include "raster.h"
+#include "job.h"
+
+// farthest depth of occluders that cover an entry completely, 1.0 where nothing does
+static float *occlusion_buffer = NULL;
+static int occlusion_width = 0;
+static int occlusion_height = 0;
+
+static int num_occluded_meshes = 0;
+static int num_occluded_triangles = 0;
+
+typedef struct {
+    render_packet_t **segments;
+    int num_segments;
+} occluder_job_t;
+
+void init_occlusion(void){
+    occlusion_width = (getWindowWidth() + OCCLUSION_SCALE - 1) / OCCLUSION_SCALE;
+    occlusion_height = (getWindowHeight() + OCCLUSION_SCALE - 1) / OCCLUSION_SCALE;
+    occlusion_buffer = (float*) malloc(occlusion_width * occlusion_height * sizeof(float));
+}
+
+int getOccludedMeshCount(void){
+    return num_occluded_meshes;
+}
+
+int getOccludedTriangleCount(void){
+    return num_occluded_triangles;
+}
+
+static void raster_occluder_triangle(render_packet_t *packet, rect_t clip){
+    // set up at full resolution so coverage matches the screen rasterizer exactly
+    int x[3], y[3];
+    for (int i = 0; i < 3; i++){
+        x[i] = packet->x[i];
+        y[i] = packet->y[i];
+    }
+    // most triangles miss the band of the job entirely
+    if ((y[0] < clip.min_y && y[1] < clip.min_y && y[2] < clip.min_y) ||
+        (y[0] > clip.max_y && y[1] > clip.max_y && y[2] > clip.max_y)) return;
+    triangle_setup_t setup;
+    if (!setup_triangle(&setup, x, y, packet->inv_w, NULL, NULL, clip)) return;
+
+    const int last = OCCLUSION_SCALE - 1;
+    int min_offset[3];
+    for (int i = 0; i < 3; i++){
+        int step_x = setup.edges[i].a * last;
+        int step_y = setup.edges[i].b * last;
+        min_offset[i] = (step_x < 0 ? step_x : 0) + (step_y < 0 ? step_y : 0);
+    }
+    float inv_w_offset = (setup.inv_w.dx < 0 ? setup.inv_w.dx * last : 0) + (setup.inv_w.dy < 0 ? setup.inv_w.dy * last : 0);
+
+    for (int y = setup.min_y / OCCLUSION_SCALE; y <= setup.max_y / OCCLUSION_SCALE; y++){
+        for (int x = setup.min_x / OCCLUSION_SCALE; x <= setup.max_x / OCCLUSION_SCALE; x++){
+            int pixel_x = x * OCCLUSION_SCALE;
+            int pixel_y = y * OCCLUSION_SCALE;
+
+            // only entries whose every pixel is covered may hide anything
+            bool covered = true;
+            for (int i = 0; i < 3; i++){
+                edge_function_t *edge = &setup.edges[i];
+                if (edge->a * pixel_x + edge->b * pixel_y + edge->c + min_offset[i] < 0){
+                    covered = false;
+                    break;
+                }
+            }
+            if (!covered) continue;
+
+            // the farthest point of the entry is at the corner with the smallest 1/w
+            float inv_w = setup.inv_w.origin + setup.inv_w.dx * (pixel_x - setup.x0) + setup.inv_w.dy * (pixel_y - setup.y0) + inv_w_offset;
+            float depth = 1.0 - inv_w;
+            float *entry = &occlusion_buffer[y * occlusion_width + x];
+            if (depth < *entry) *entry = depth;
+        }
+    }
+}
+
+// every job owns a band of rows, entries only ever get closer so the order of the triangles does not matter
+static void raster_occluder_band(int job_index, void *data){
+    occluder_job_t *job = (occluder_job_t*) data;
+    int first_row = job_index * OCCLUSION_BAND_ROWS;
+    int end_row = first_row + OCCLUSION_BAND_ROWS < occlusion_height ? first_row + OCCLUSION_BAND_ROWS : occlusion_height;
+    for (int i = first_row * occlusion_width; i < end_row * occlusion_width; i++){
+        occlusion_buffer[i] = 1.0;
+    }
+
+    // the band starts on an entry boundary, so no entry is split between two jobs
+    rect_t clip = getScreenRect();
+    clip.min_y = first_row * OCCLUSION_SCALE;
+    if (end_row * OCCLUSION_SCALE - 1 < clip.max_y) clip.max_y = end_row * OCCLUSION_SCALE - 1;
+
+    for (int i = 0; i < job->num_segments; i++){
+        render_packet_t *triangles = job->segments[i];
+        for (int j = 0; j < array_size(triangles); j++){
+            raster_occluder_triangle(&triangles[j], clip);
+        }
+    }
+}
+
+void render_occluders(render_packet_t **segments, int num_segments){
+    num_occluded_meshes = 0;
+    num_occluded_triangles = 0;
+
+    occluder_job_t job;
+    job.segments = segments;
+    job.num_segments = num_segments;
+    run_jobs(raster_occluder_band, &job, (occlusion_height + OCCLUSION_BAND_ROWS - 1) / OCCLUSION_BAND_ROWS);
+}
+
+bool is_mesh_occluded(mesh_t *mesh){
+    // screen rectangle and nearest depth of the projected bounding box
+    float min_x = getWindowWidth(), min_y = getWindowHeight();
+    float max_x = 0, max_y = 0;
+    float min_w = 0;
+    for (int i = 0; i < 8; i++){
+        vec4_t corner = {
+            (i & 1) ? mesh->resource->bounds_max.x : mesh->resource->bounds_min.x,
+            (i & 2) ? mesh->resource->bounds_max.y : mesh->resource->bounds_min.y,
+            (i & 4) ? mesh->resource->bounds_max.z : mesh->resource->bounds_min.z,
+            1
+        };
+        vec4_t clip = mat4_mul_vec4(mesh->mvp_matrix, corner);
+        // a box reaching behind the near plane has no usable rectangle
+        if (clip.z < 0) return false;
+
+        float x = (clip.x / clip.w + 1) * getWindowWidth() / 2.0;
+        float y = (1 - clip.y / clip.w) * getWindowHeight() / 2.0;
+        if (x < min_x) min_x = x;
+        if (y < min_y) min_y = y;
+        if (x > max_x) max_x = x;
+        if (y > max_y) max_y = y;
+        if (i == 0 || clip.w < min_w) min_w = clip.w;
+    }
+
+    // widen by a pixel for the snapping of the rasterizer
+    int entry_min_x = (int)(min_x - 1) / OCCLUSION_SCALE;
+    int entry_min_y = (int)(min_y - 1) / OCCLUSION_SCALE;
+    int entry_max_x = (int)(max_x + 1) / OCCLUSION_SCALE;
+    int entry_max_y = (int)(max_y + 1) / OCCLUSION_SCALE;
+    if (entry_min_x < 0) entry_min_x = 0;
+    if (entry_min_y < 0) entry_min_y = 0;
+    if (entry_max_x > occlusion_width - 1) entry_max_x = occlusion_width - 1;
+    if (entry_max_y > occlusion_height - 1) entry_max_y = occlusion_height - 1;
+    if (entry_min_x > entry_max_x || entry_min_y > entry_max_y) return false;
+
+    float nearest_depth = 1.0 - 1.0 / min_w;
+    for (int y = entry_min_y; y <= entry_max_y; y++){
+        for (int x = entry_min_x; x <= entry_max_x; x++){
+            if (nearest_depth <= occlusion_buffer[y * occlusion_width + x]) return false;
+        }
+    }
+
+    num_occluded_meshes++;
+    num_occluded_triangles += array_size(mesh->resource->lod_faces[mesh->lod]);
+    return true;
+}
+
+void free_occlusion(void){
+    free(occlusion_buffer);
+    occlusion_buffer = NULL;
+}
@@ -0,0 +1,23 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdbool.h>
+#include "mesh.h"
+
+// every occlusion buffer entry covers this many screen pixels in each direction
+#define OCCLUSION_SCALE 4
+// rows of occlusion buffer entries one occluder raster job covers
+#define OCCLUSION_BAND_ROWS 16
+
+void init_occlusion(void);
+
+// rasterizes the triangles the geometry stage made of the occluders, segments are dynamic arrays of packets
+void render_occluders(render_packet_t **segments, int num_segments);
+bool is_mesh_occluded(mesh_t *mesh);
+
+int getOccludedMeshCount(void);
+int getOccludedTriangleCount(void);
+
+void free_occlusion(void);
+
+#endif //OCCLUSION_H
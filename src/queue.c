@@ -0,0 +1,137 @@
+#include <SDL2/SDL.h>
+#include <string.h>
+#include "queue.h"
+#include "arena.h"
+
+// key layout from the low bits up: triangle index, depth, texture id
+#define KEY_INDEX_BITS RENDER_QUEUE_INDEX_BITS
+#define KEY_DEPTH_BITS 24
+#define KEY_TEXTURE_BITS 16
+#define KEY_INDEX_MASK ((1 << KEY_INDEX_BITS) - 1)
+#define KEY_RADIX_BITS 8
+#define KEY_RADIX_PASSES (64 / KEY_RADIX_BITS)
+
+int SortMode_Policy = SORT_HYBRID;
+
+// milliseconds spent sorting the last frame
+static float sort_time = 0;
+
+const char *getSortPolicyName(int policy){
+    switch (policy) {
+        case SORT_FRONT_TO_BACK: return "front to back";
+        case SORT_BY_TEXTURE: return "by texture";
+        case SORT_HYBRID: return "by texture, then front to back";
+        default: return "submission order";
+    }
+}
+
+float getSortTime(void){
+    return sort_time;
+}
+
+void alloc_render_queue(render_queue_t *queue, int count){
+    for (int i = 0; i < 3; i++){
+        queue->x[i] = (int16_t*) frame_alloc(count * sizeof(int16_t));
+        queue->y[i] = (int16_t*) frame_alloc(count * sizeof(int16_t));
+        queue->inv_w[i] = (float*) frame_alloc(count * sizeof(float));
+        queue->u[i] = (int16_t*) frame_alloc(count * sizeof(int16_t));
+        queue->v[i] = (int16_t*) frame_alloc(count * sizeof(int16_t));
+    }
+    queue->color = (uint32_t*) frame_alloc(count * sizeof(uint32_t));
+    queue->material = (uint16_t*) frame_alloc(count * sizeof(uint16_t));
+    queue->count = count;
+}
+
+uint64_t make_sort_key(const render_packet_t *packet, int index){
+    // 1/w of the nearest vertex, the bits of a positive float sort like the float itself,
+    // inverted so nearer triangles come first
+    float nearest_inv_w = packet->inv_w[0];
+    if (packet->inv_w[1] > nearest_inv_w) nearest_inv_w = packet->inv_w[1];
+    if (packet->inv_w[2] > nearest_inv_w) nearest_inv_w = packet->inv_w[2];
+    if (!(nearest_inv_w > 0)) nearest_inv_w = 0;
+
+    uint32_t inv_w_bits;
+    memcpy(&inv_w_bits, &nearest_inv_w, sizeof(inv_w_bits));
+    uint64_t depth = (~inv_w_bits & 0x7FFFFFFF) >> (31 - KEY_DEPTH_BITS);
+    uint64_t texture = (uint64_t)packet->material & ((1 << KEY_TEXTURE_BITS) - 1);
+
+    // the index in the low bits keeps the sort stable and locates the triangle
+    uint64_t key = (uint64_t)index & KEY_INDEX_MASK;
+    switch (SortMode_Policy) {
+        case SORT_FRONT_TO_BACK:
+            key |= depth << KEY_INDEX_BITS;
+            break;
+        case SORT_BY_TEXTURE:
+            key |= texture << (KEY_INDEX_BITS + KEY_DEPTH_BITS);
+            break;
+        case SORT_HYBRID:
+            key |= depth << KEY_INDEX_BITS;
+            key |= texture << (KEY_INDEX_BITS + KEY_DEPTH_BITS);
+            break;
+    }
+    return key;
+}
+
+static void radix_sort_keys(uint64_t *keys, int num_keys){
+    // histogram every digit in a single pass over the keys
+    int counts[KEY_RADIX_PASSES][1 << KEY_RADIX_BITS];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < num_keys; i++){
+        for (int pass = 0; pass < KEY_RADIX_PASSES; pass++){
+            counts[pass][(keys[i] >> (pass * KEY_RADIX_BITS)) & 0xFF]++;
+        }
+    }
+
+    uint64_t *scratch_keys = (uint64_t*) frame_alloc(num_keys * sizeof(uint64_t));
+
+    uint64_t *source = keys;
+    uint64_t *destination = scratch_keys;
+    for (int pass = 0; pass < KEY_RADIX_PASSES; pass++){
+        int shift = pass * KEY_RADIX_BITS;
+
+        // a digit shared by every key does not change the order
+        if (counts[pass][(keys[0] >> shift) & 0xFF] == num_keys) continue;
+
+        int offset = 0;
+        for (int digit = 0; digit < (1 << KEY_RADIX_BITS); digit++){
+            int count = counts[pass][digit];
+            counts[pass][digit] = offset;
+            offset += count;
+        }
+        for (int i = 0; i < num_keys; i++){
+            destination[counts[pass][(source[i] >> shift) & 0xFF]++] = source[i];
+        }
+
+        uint64_t *swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != keys){
+        memcpy(keys, source, num_keys * sizeof(uint64_t));
+    }
+}
+
+void sort_render_keys(uint64_t *keys, int count){
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (SortMode_Policy != SORT_SUBMISSION && count > 1){
+        radix_sort_keys(keys, count);
+    }
+    sort_time = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void gather_render_queue(render_queue_t *queue, render_packet_t **packets, const uint64_t *keys, int first, int count){
+    // packets are read in key order and every queue array is written front to back
+    for (int k = first; k < first + count; k++){
+        const render_packet_t *packet = packets[keys[k] & KEY_INDEX_MASK];
+        for (int i = 0; i < 3; i++){
+            queue->x[i][k] = packet->x[i];
+            queue->y[i][k] = packet->y[i];
+            queue->inv_w[i][k] = packet->inv_w[i];
+            queue->u[i][k] = packet->u[i];
+            queue->v[i][k] = packet->v[i];
+        }
+        queue->color[k] = packet->color;
+        queue->material[k] = packet->material;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdint.h>
+#include "triangle.h"
+
+// how the render queue is ordered before rasterization
+enum {
+    SORT_SUBMISSION,
+    SORT_FRONT_TO_BACK,
+    SORT_BY_TEXTURE,
+    SORT_HYBRID,
+    NUM_SORT_POLICIES
+};
+
+// sort keys locate their triangle in this many bits, which caps the triangles queued in a frame
+#define RENDER_QUEUE_INDEX_BITS 24
+#define MAX_RENDER_QUEUE_SIZE (1 << RENDER_QUEUE_INDEX_BITS)
+
+extern int SortMode_Policy;
+
+const char *getSortPolicyName(int policy);
+float getSortTime(void);
+
+// the queue arrays are allocated from the frame arena
+void alloc_render_queue(render_queue_t *queue, int count);
+
+uint64_t make_sort_key(const render_packet_t *packet, int index);
+// orders the keys by the selected policy, every key keeps the index it was made with
+void sort_render_keys(uint64_t *keys, int count);
+// fills count queue positions from first on with the packets the keys at those positions were made from
+void gather_render_queue(render_queue_t *queue, render_packet_t **packets, const uint64_t *keys, int first, int count);
+
+#endif //QUEUE_H
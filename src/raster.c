@@ -0,0 +1,483 @@
+#include <stdlib.h>
+#include <math.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "raster.h"
+
+static edge_function_t edge_from_points(int x0, int y0, int x1, int y1){
+    edge_function_t edge;
+    edge.a = y0 - y1;
+    edge.b = x1 - x0;
+    edge.c = -(edge.a * x0) - (edge.b * y0);
+
+    // the span rule of the scanline rasterizer, so both paths cover the same pixels: every row from the top
+    // to the bottom vertex, and in a row the pixels from the truncated left edge up to, but not including,
+    // the truncated right edge. a > 0 is a left edge, x >= floor(left) holds when E + a > 0
+    if (edge.a > 0) edge.c += edge.a - 1;
+    // a < 0 is a right edge, x < floor(right) holds when E(x + 1, y) >= 0
+    if (edge.a < 0) edge.c += edge.a;
+
+    return edge;
+}
+
+static attribute_plane_t attribute_plane(
+    float f0, float f1, float f2,
+    float dx1, float dy1, float dx2, float dy2, float inv_det
+){
+    attribute_plane_t plane;
+    plane.origin = f0;
+    plane.dx = ((f1 - f0) * dy2 - (f2 - f0) * dy1) * inv_det;
+    plane.dy = ((f2 - f0) * dx1 - (f1 - f0) * dx2) * inv_det;
+    return plane;
+}
+
+static float attribute_at(attribute_plane_t *plane, int x0, int y0, int x, int y){
+    return plane->origin + plane->dx * (x - x0) + plane->dy * (y - y0);
+}
+
+bool clip_triangle_setup(triangle_setup_t *setup, rect_t clip){
+    // clamp bounding box to the clip rectangle
+    if (setup->min_x < clip.min_x) setup->min_x = clip.min_x;
+    if (setup->min_y < clip.min_y) setup->min_y = clip.min_y;
+    if (setup->max_x > clip.max_x) setup->max_x = clip.max_x;
+    if (setup->max_y > clip.max_y) setup->max_y = clip.max_y;
+    return setup->min_x <= setup->max_x && setup->min_y <= setup->max_y;
+}
+
+bool setup_triangle(
+    triangle_setup_t *setup, const int x[3], const int y[3],
+    const float inv_w[3], const float *u_over_w, const float *v_over_w, rect_t clip
+){
+    int i1 = 1;
+    int i2 = 2;
+
+    int det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (det == 0) return false;
+
+    // keep the winding so that the inside of the triangle is positive for every edge
+    if (det < 0){
+        i1 = 2;
+        i2 = 1;
+        det = -det;
+    }
+
+    int min_x = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+    int min_y = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+    int max_x = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+    int max_y = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+
+    setup->min_x = min_x;
+    setup->min_y = min_y;
+    setup->max_x = max_x;
+    setup->max_y = max_y;
+    if (!clip_triangle_setup(setup, clip)) return false;
+    setup->x0 = x[0];
+    setup->y0 = y[0];
+
+    setup->edges[0] = edge_from_points(x[i1], y[i1], x[i2], y[i2]);
+    setup->edges[1] = edge_from_points(x[i2], y[i2], x[0], y[0]);
+    setup->edges[2] = edge_from_points(x[0], y[0], x[i1], y[i1]);
+
+    // attribute gradients are set up once per triangle, in the original vertex order
+    float dx1 = x[1] - x[0];
+    float dy1 = y[1] - y[0];
+    float dx2 = x[2] - x[0];
+    float dy2 = y[2] - y[0];
+    float inv_det = 1.0 / (dx1 * dy2 - dx2 * dy1);
+
+    setup->inv_w = attribute_plane(inv_w[0], inv_w[1], inv_w[2], dx1, dy1, dx2, dy2, inv_det);
+    setup->max_inv_w = inv_w[0] > inv_w[1] ? (inv_w[0] > inv_w[2] ? inv_w[0] : inv_w[2]) : (inv_w[1] > inv_w[2] ? inv_w[1] : inv_w[2]);
+    // the span rule covers pixels up to one pixel outside the triangle, where 1/w can pass every vertex
+    setup->max_inv_w += fabsf(setup->inv_w.dx) + fabsf(setup->inv_w.dy);
+
+    if (u_over_w != NULL){
+        setup->u_over_w = attribute_plane(u_over_w[0], u_over_w[1], u_over_w[2], dx1, dy1, dx2, dy2, inv_det);
+        setup->v_over_w = attribute_plane(v_over_w[0], v_over_w[1], v_over_w[2], dx1, dy1, dx2, dy2, inv_det);
+    }
+    else {
+        attribute_plane_t empty = {0, 0, 0};
+        setup->u_over_w = empty;
+        setup->v_over_w = empty;
+    }
+
+    return true;
+}
+
+bool setup_queue_triangle(triangle_setup_t *setup, const render_queue_t *queue, int index, bool textured, rect_t clip){
+    int x[3], y[3];
+    float inv_w[3], u_over_w[3], v_over_w[3];
+    for (int i = 0; i < 3; i++){
+        x[i] = queue->x[i][index];
+        y[i] = queue->y[i][index];
+        inv_w[i] = queue->inv_w[i][index];
+    }
+    if (!textured) return setup_triangle(setup, x, y, inv_w, NULL, NULL, clip);
+
+    // texture coordinates are divided by w once per corner instead of in the clipper
+    for (int i = 0; i < 3; i++){
+        u_over_w[i] = queue->u[i][index] * (inv_w[i] / TEXCOORD_SCALE);
+        v_over_w[i] = queue->v[i][index] * (inv_w[i] / TEXCOORD_SCALE);
+    }
+    return setup_triangle(setup, x, y, inv_w, u_over_w, v_over_w, clip);
+}
+
+void raster_texture_from_upng(raster_texture_t *raster_texture, upng_t *texture){
+    raster_texture->buffer = (uint32_t*) upng_get_buffer(texture);
+    raster_texture->width = upng_get_width(texture);
+    raster_texture->height = upng_get_height(texture);
+    raster_texture->width_mask = (raster_texture->width & (raster_texture->width - 1)) == 0 ? raster_texture->width - 1 : -1;
+    raster_texture->height_mask = (raster_texture->height & (raster_texture->height - 1)) == 0 ? raster_texture->height - 1 : -1;
+}
+
+#if defined(__AVX2__)
+
+// shade a full row of 8 pixels with one 8-wide AVX2 kernel
+static bool raster_row_simd(
+    triangle_setup_t *setup, int index, int e0, int e1, int e2,
+    float inv_w, float u_over_w, float v_over_w, bool accept,
+    uint32_t color, raster_texture_t *texture, uint32_t *target
+){
+    float *z_buffer = getZBuffer();
+
+    __m256i lane_i = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 lane = _mm256_cvtepi32_ps(lane_i);
+
+    // coverage from the sign bits of the three edge functions
+    __m256i mask = _mm256_set1_epi32(-1);
+    if (!accept){
+        __m256i edge_0 = _mm256_add_epi32(_mm256_set1_epi32(e0), _mm256_mullo_epi32(_mm256_set1_epi32(setup->edges[0].a), lane_i));
+        __m256i edge_1 = _mm256_add_epi32(_mm256_set1_epi32(e1), _mm256_mullo_epi32(_mm256_set1_epi32(setup->edges[1].a), lane_i));
+        __m256i edge_2 = _mm256_add_epi32(_mm256_set1_epi32(e2), _mm256_mullo_epi32(_mm256_set1_epi32(setup->edges[2].a), lane_i));
+        __m256i edges = _mm256_or_si256(_mm256_or_si256(edge_0, edge_1), edge_2);
+        mask = _mm256_cmpgt_epi32(edges, _mm256_set1_epi32(-1));
+    }
+
+    // masked depth test, smaller values mean closer to screen
+    __m256 inv_w_row = _mm256_add_ps(_mm256_set1_ps(inv_w), _mm256_mul_ps(_mm256_set1_ps(setup->inv_w.dx), lane));
+    __m256 depth = _mm256_sub_ps(_mm256_set1_ps(1.0f), inv_w_row);
+    __m256 depth_buffer = _mm256_loadu_ps(&z_buffer[index]);
+    mask = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(depth, depth_buffer, _CMP_LT_OQ)));
+    if (_mm256_testz_si256(mask, mask)) return false;
+
+    __m256i old_colors = _mm256_loadu_si256((__m256i*) &target[index]);
+    __m256i colors;
+
+    if (texture != NULL){
+        // perspective divide and texel addressing for all lanes at once
+        __m256 u = _mm256_add_ps(_mm256_set1_ps(u_over_w), _mm256_mul_ps(_mm256_set1_ps(setup->u_over_w.dx), lane));
+        __m256 v = _mm256_add_ps(_mm256_set1_ps(v_over_w), _mm256_mul_ps(_mm256_set1_ps(setup->v_over_w.dx), lane));
+        u = _mm256_div_ps(u, inv_w_row);
+        v = _mm256_div_ps(v, inv_w_row);
+
+        __m256i texel_x = _mm256_abs_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps(texture->width))));
+        __m256i texel_y = _mm256_abs_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(texture->height))));
+
+        if (texture->width_mask >= 0 && texture->height_mask >= 0){
+            texel_x = _mm256_and_si256(texel_x, _mm256_set1_epi32(texture->width_mask));
+            texel_y = _mm256_and_si256(texel_y, _mm256_set1_epi32(texture->height_mask));
+        }
+        else {
+            // no integer division in SIMD, wrap non power of two sizes per lane
+            int lanes_x[8], lanes_y[8];
+            _mm256_storeu_si256((__m256i*) lanes_x, texel_x);
+            _mm256_storeu_si256((__m256i*) lanes_y, texel_y);
+            for (int i = 0; i < 8; i++){
+                lanes_x[i] %= texture->width;
+                lanes_y[i] %= texture->height;
+            }
+            texel_x = _mm256_loadu_si256((__m256i*) lanes_x);
+            texel_y = _mm256_loadu_si256((__m256i*) lanes_y);
+        }
+
+        __m256i texel_index = _mm256_add_epi32(_mm256_mullo_epi32(texel_y, _mm256_set1_epi32(texture->width)), texel_x);
+        colors = _mm256_mask_i32gather_epi32(old_colors, (const int*) texture->buffer, texel_index, mask, 4);
+    }
+    else {
+        colors = _mm256_set1_epi32(color);
+    }
+
+    // masked store of color and depth
+    _mm256_storeu_si256((__m256i*) &target[index], _mm256_blendv_epi8(old_colors, colors, mask));
+    _mm256_storeu_ps(&z_buffer[index], _mm256_blendv_ps(depth_buffer, depth, _mm256_castsi256_ps(mask)));
+    return true;
+}
+
+#elif defined(__SSE2__)
+
+// shade 4 pixels with one SSE2 kernel
+static bool raster_quad_simd(
+    triangle_setup_t *setup, int index, __m128 lane,
+    int e0, int e1, int e2, float inv_w, float u_over_w, float v_over_w, bool accept,
+    uint32_t color, raster_texture_t *texture, uint32_t *target
+){
+    float *z_buffer = getZBuffer();
+
+    // coverage from the sign bits of the three edge functions, SSE2 has no 32 bit multiply but the lane offsets are exact in float
+    __m128i mask = _mm_set1_epi32(-1);
+    if (!accept){
+        __m128i edge_0 = _mm_add_epi32(_mm_set1_epi32(e0), _mm_cvtps_epi32(_mm_mul_ps(_mm_set1_ps(setup->edges[0].a), lane)));
+        __m128i edge_1 = _mm_add_epi32(_mm_set1_epi32(e1), _mm_cvtps_epi32(_mm_mul_ps(_mm_set1_ps(setup->edges[1].a), lane)));
+        __m128i edge_2 = _mm_add_epi32(_mm_set1_epi32(e2), _mm_cvtps_epi32(_mm_mul_ps(_mm_set1_ps(setup->edges[2].a), lane)));
+        __m128i edges = _mm_or_si128(_mm_or_si128(edge_0, edge_1), edge_2);
+        mask = _mm_cmpgt_epi32(edges, _mm_set1_epi32(-1));
+    }
+
+    // masked depth test, smaller values mean closer to screen
+    __m128 inv_w_quad = _mm_add_ps(_mm_set1_ps(inv_w), _mm_mul_ps(_mm_set1_ps(setup->inv_w.dx), lane));
+    __m128 depth = _mm_sub_ps(_mm_set1_ps(1.0f), inv_w_quad);
+    __m128 depth_buffer = _mm_loadu_ps(&z_buffer[index]);
+    mask = _mm_and_si128(mask, _mm_castps_si128(_mm_cmplt_ps(depth, depth_buffer)));
+    if (_mm_movemask_epi8(mask) == 0) return false;
+
+    __m128i old_colors = _mm_loadu_si128((__m128i*) &target[index]);
+    __m128i colors;
+
+    if (texture != NULL){
+        // perspective divide and texel addressing for all lanes at once
+        __m128 u = _mm_add_ps(_mm_set1_ps(u_over_w), _mm_mul_ps(_mm_set1_ps(setup->u_over_w.dx), lane));
+        __m128 v = _mm_add_ps(_mm_set1_ps(v_over_w), _mm_mul_ps(_mm_set1_ps(setup->v_over_w.dx), lane));
+        u = _mm_div_ps(u, inv_w_quad);
+        v = _mm_div_ps(v, inv_w_quad);
+
+        __m128i texel_x = _mm_cvttps_epi32(_mm_mul_ps(u, _mm_set1_ps(texture->width)));
+        __m128i texel_y = _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(texture->height)));
+        // absolute value without SSSE3
+        __m128i sign_x = _mm_srai_epi32(texel_x, 31);
+        __m128i sign_y = _mm_srai_epi32(texel_y, 31);
+        texel_x = _mm_sub_epi32(_mm_xor_si128(texel_x, sign_x), sign_x);
+        texel_y = _mm_sub_epi32(_mm_xor_si128(texel_y, sign_y), sign_y);
+
+        // SSE2 has no gather, fetch the covered texels per lane
+        int lanes_x[4], lanes_y[4], lanes_mask[4];
+        uint32_t texels[4];
+        _mm_storeu_si128((__m128i*) lanes_x, texel_x);
+        _mm_storeu_si128((__m128i*) lanes_y, texel_y);
+        _mm_storeu_si128((__m128i*) lanes_mask, mask);
+        for (int i = 0; i < 4; i++){
+            texels[i] = 0;
+            if (lanes_mask[i] == 0) continue;
+            int x = texture->width_mask >= 0 ? lanes_x[i] & texture->width_mask : lanes_x[i] % texture->width;
+            int y = texture->height_mask >= 0 ? lanes_y[i] & texture->height_mask : lanes_y[i] % texture->height;
+            texels[i] = texture->buffer[y * texture->width + x];
+        }
+        colors = _mm_loadu_si128((__m128i*) texels);
+    }
+    else {
+        colors = _mm_set1_epi32(color);
+    }
+
+    // masked store of color and depth
+    __m128i new_colors = _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, old_colors));
+    __m128 new_depth = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(mask), depth), _mm_andnot_ps(_mm_castsi128_ps(mask), depth_buffer));
+    _mm_storeu_si128((__m128i*) &target[index], new_colors);
+    _mm_storeu_ps(&z_buffer[index], new_depth);
+    return true;
+}
+
+// shade a full row of 8 pixels as two SSE2 quads
+static bool raster_row_simd(
+    triangle_setup_t *setup, int index, int e0, int e1, int e2,
+    float inv_w, float u_over_w, float v_over_w, bool accept,
+    uint32_t color, raster_texture_t *texture, uint32_t *target
+){
+    __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    bool written = raster_quad_simd(setup, index, lane, e0, e1, e2, inv_w, u_over_w, v_over_w, accept, color, texture, target);
+
+    // the second quad starts 4 pixels further right
+    lane = _mm_add_ps(lane, _mm_set1_ps(4.0f));
+    written |= raster_quad_simd(setup, index + 4, lane, e0, e1, e2, inv_w, u_over_w, v_over_w, accept, color, texture, target);
+    return written;
+}
+
+#endif
+
+// returns whether any pixel of the block was written
+static bool raster_block(
+    triangle_setup_t *setup, int start_x, int start_y, int end_x, int end_y, bool accept,
+    uint32_t color, raster_texture_t *texture, uint32_t *target
+){
+    float *z_buffer = getZBuffer();
+    int window_width = getWindowWidth();
+
+    edge_function_t *edges = setup->edges;
+    bool written = false;
+
+    int row_e0 = edges[0].a * start_x + edges[0].b * start_y + edges[0].c;
+    int row_e1 = edges[1].a * start_x + edges[1].b * start_y + edges[1].c;
+    int row_e2 = edges[2].a * start_x + edges[2].b * start_y + edges[2].c;
+
+    float row_inv_w = attribute_at(&setup->inv_w, setup->x0, setup->y0, start_x, start_y);
+    float row_u = 0;
+    float row_v = 0;
+    if (texture != NULL){
+        row_u = attribute_at(&setup->u_over_w, setup->x0, setup->y0, start_x, start_y);
+        row_v = attribute_at(&setup->v_over_w, setup->x0, setup->y0, start_x, start_y);
+    }
+
+#if defined(__SSE2__) || defined(__AVX2__)
+    // rows spanning the whole block go through the wide kernels, partial rows at the clip border stay scalar
+    bool is_full_row = end_x - start_x + 1 == RASTER_BLOCK_SIZE;
+#endif
+
+    for (int y = start_y; y <= end_y; y++){
+#if defined(__SSE2__) || defined(__AVX2__)
+        if (is_full_row){
+            written |= raster_row_simd(
+                setup, y * window_width + start_x, row_e0, row_e1, row_e2,
+                row_inv_w, row_u, row_v, accept, color, texture, target
+            );
+
+            row_e0 += edges[0].b;
+            row_e1 += edges[1].b;
+            row_e2 += edges[2].b;
+            row_inv_w += setup->inv_w.dy;
+            row_u += setup->u_over_w.dy;
+            row_v += setup->v_over_w.dy;
+            continue;
+        }
+#endif
+
+        int e0 = row_e0;
+        int e1 = row_e1;
+        int e2 = row_e2;
+        float inv_w = row_inv_w;
+        float u_over_w = row_u;
+        float v_over_w = row_v;
+
+        for (int x = start_x; x <= end_x; x++){
+            // covered when no edge value is negative
+            if (accept || (e0 | e1 | e2) >= 0){
+                // override inv_w so that smaller values mean closer to screen
+                float depth = 1.0 - inv_w;
+                int index = y * window_width + x;
+
+                if (depth < z_buffer[index]){
+                    if (texture != NULL){
+                        float u = u_over_w / inv_w;
+                        float v = v_over_w / inv_w;
+                        int texel_x = abs((int)(u * texture->width)) % texture->width;
+                        int texel_y = abs((int)(v * texture->height)) % texture->height;
+                        target[index] = texture->buffer[texel_y * texture->width + texel_x];
+                    }
+                    else {
+                        target[index] = color;
+                    }
+                    z_buffer[index] = depth;
+                    written = true;
+                }
+            }
+
+            e0 += edges[0].a;
+            e1 += edges[1].a;
+            e2 += edges[2].a;
+            inv_w += setup->inv_w.dx;
+            u_over_w += setup->u_over_w.dx;
+            v_over_w += setup->v_over_w.dx;
+        }
+
+        row_e0 += edges[0].b;
+        row_e1 += edges[1].b;
+        row_e2 += edges[2].b;
+        row_inv_w += setup->inv_w.dy;
+        row_u += setup->u_over_w.dy;
+        row_v += setup->v_over_w.dy;
+    }
+
+    return written;
+}
+
+static bool is_triangle_occluded(triangle_setup_t *setup, float *hiz_buffer, int hiz_width){
+    // the nearest vertex is behind the farthest depth of every block the bounding box touches
+    float nearest_depth = 1.0 - setup->max_inv_w;
+    for (int block_y = setup->min_y / RASTER_BLOCK_SIZE; block_y <= setup->max_y / RASTER_BLOCK_SIZE; block_y++){
+        for (int block_x = setup->min_x / RASTER_BLOCK_SIZE; block_x <= setup->max_x / RASTER_BLOCK_SIZE; block_x++){
+            if (nearest_depth < hiz_buffer[block_y * hiz_width + block_x]) return false;
+        }
+    }
+    return true;
+}
+
+static void raster_triangle(triangle_setup_t *setup, uint32_t color, raster_texture_t *texture, uint32_t *target){
+    // offsets from the block origin to the corner where each edge is largest and smallest
+    int max_offset[3], min_offset[3];
+    for (int i = 0; i < 3; i++){
+        edge_function_t *edge = &setup->edges[i];
+        int step_x = edge->a * (RASTER_BLOCK_SIZE - 1);
+        int step_y = edge->b * (RASTER_BLOCK_SIZE - 1);
+        max_offset[i] = (step_x > 0 ? step_x : 0) + (step_y > 0 ? step_y : 0);
+        min_offset[i] = (step_x < 0 ? step_x : 0) + (step_y < 0 ? step_y : 0);
+    }
+
+    // walk blocks aligned to the screen grid
+    int block_min_x = setup->min_x & ~(RASTER_BLOCK_SIZE - 1);
+    int block_min_y = setup->min_y & ~(RASTER_BLOCK_SIZE - 1);
+
+    float *hiz_buffer = getHiZBuffer();
+    int hiz_width = getHiZWidth();
+
+    // offsets from the block origin to the corner where 1/w is largest
+    float inv_w_step_x = setup->inv_w.dx * (RASTER_BLOCK_SIZE - 1);
+    float inv_w_step_y = setup->inv_w.dy * (RASTER_BLOCK_SIZE - 1);
+    float inv_w_max_offset = (inv_w_step_x > 0 ? inv_w_step_x : 0) + (inv_w_step_y > 0 ? inv_w_step_y : 0);
+
+    if (RasterMode_HiZ && is_triangle_occluded(setup, hiz_buffer, hiz_width)) return;
+
+    for (int block_y = block_min_y; block_y <= setup->max_y; block_y += RASTER_BLOCK_SIZE){
+        for (int block_x = block_min_x; block_x <= setup->max_x; block_x += RASTER_BLOCK_SIZE){
+            bool reject = false;
+            bool accept = true;
+
+            for (int i = 0; i < 3; i++){
+                edge_function_t *edge = &setup->edges[i];
+                int corner = edge->a * block_x + edge->b * block_y + edge->c;
+                if (corner + max_offset[i] < 0){
+                    reject = true;
+                    break;
+                }
+                if (corner + min_offset[i] < 0) accept = false;
+            }
+            if (reject) continue;
+
+            int hiz_index = (block_y / RASTER_BLOCK_SIZE) * hiz_width + block_x / RASTER_BLOCK_SIZE;
+            if (RasterMode_HiZ){
+                // the nearest point of the triangle inside this block is behind everything drawn there
+                float max_inv_w = attribute_at(&setup->inv_w, setup->x0, setup->y0, block_x, block_y) + inv_w_max_offset;
+                if (max_inv_w > setup->max_inv_w) max_inv_w = setup->max_inv_w;
+                if (1.0 - max_inv_w >= hiz_buffer[hiz_index]) continue;
+            }
+
+            int start_x = block_x > setup->min_x ? block_x : setup->min_x;
+            int start_y = block_y > setup->min_y ? block_y : setup->min_y;
+            int end_x = block_x + RASTER_BLOCK_SIZE - 1 < setup->max_x ? block_x + RASTER_BLOCK_SIZE - 1 : setup->max_x;
+            int end_y = block_y + RASTER_BLOCK_SIZE - 1 < setup->max_y ? block_y + RASTER_BLOCK_SIZE - 1 : setup->max_y;
+
+            if (raster_block(setup, start_x, start_y, end_x, end_y, accept, color, texture, target)){
+                update_hiz_block(block_x / RASTER_BLOCK_SIZE, block_y / RASTER_BLOCK_SIZE);
+            }
+        }
+    }
+}
+
+void raster_filled_triangle(const render_queue_t *queue, int index, rect_t clip){
+    triangle_setup_t setup;
+    if (!setup_queue_triangle(&setup, queue, index, false, clip)) return;
+    raster_triangle(&setup, queue->color[index], NULL, getColorBuffer());
+}
+
+void raster_textured_triangle(const render_queue_t *queue, int index, rect_t clip){
+    triangle_setup_t setup;
+    upng_t *texture_data = getMaterialTexture(queue->material[index]);
+    if (texture_data == NULL) return;
+    if (!setup_queue_triangle(&setup, queue, index, true, clip)) return;
+
+    raster_texture_t texture;
+    raster_texture_from_upng(&texture, texture_data);
+    raster_triangle(&setup, 0, &texture, getColorBuffer());
+}
+
+void raster_triangle_id(triangle_setup_t *setup, uint32_t id, uint32_t *target){
+    raster_triangle(setup, id, NULL, target);
+}
@@ -0,0 +1,63 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vector.h"
+#include "texture.h"
+#include "triangle.h"
+#include "upng.h"
+#include "display.h"
+
+// triangles are traversed in screen aligned square blocks, one per coarse depth entry
+#define RASTER_BLOCK_SIZE HIZ_BLOCK_SIZE
+
+// half-space edge function E(x, y) = a * x + b * y + c, a pixel is covered when E >= 0 for all edges
+typedef struct {
+    int a, b, c;
+} edge_function_t;
+
+// attribute interpolated linearly in screen space, value(x, y) = origin + dx * (x - x0) + dy * (y - y0)
+typedef struct {
+    float origin;
+    float dx, dy;
+} attribute_plane_t;
+
+typedef struct {
+    // bounding box clamped to the clip rectangle, inclusive
+    int min_x, min_y, max_x, max_y;
+    // screen position where the attribute planes are anchored
+    int x0, y0;
+    edge_function_t edges[3];
+    attribute_plane_t inv_w;
+    // largest 1/w of the three vertices widened by one pixel step, the nearest point the triangle covers
+    float max_inv_w;
+    attribute_plane_t u_over_w;
+    attribute_plane_t v_over_w;
+} triangle_setup_t;
+
+// texture state resolved once per triangle
+typedef struct {
+    uint32_t *buffer;
+    int width, height;
+    // width - 1 and height - 1 for power of two sizes, otherwise -1
+    int width_mask, height_mask;
+} raster_texture_t;
+
+void raster_texture_from_upng(raster_texture_t *raster_texture, upng_t *texture);
+
+// positions in whole pixels, u_over_w and v_over_w may be NULL for untextured triangles
+bool setup_triangle(
+    triangle_setup_t *setup, const int x[3], const int y[3],
+    const float inv_w[3], const float *u_over_w, const float *v_over_w, rect_t clip
+);
+bool setup_queue_triangle(triangle_setup_t *setup, const render_queue_t *queue, int index, bool textured, rect_t clip);
+bool clip_triangle_setup(triangle_setup_t *setup, rect_t clip);
+
+// the clip rectangle must start on a block boundary for results to be independent of it
+void raster_filled_triangle(const render_queue_t *queue, int index, rect_t clip);
+void raster_textured_triangle(const render_queue_t *queue, int index, rect_t clip);
+// depth tested like a filled triangle, but writes the id into target instead of a color
+void raster_triangle_id(triangle_setup_t *setup, uint32_t id, uint32_t *target);
+
+#endif //RASTER_H
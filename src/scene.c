@@ -0,0 +1,264 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scene.h"
+#include "array.h"
+#include "frame.h"
+#include "clipping.h"
+
+// deepest tree the traversal stack can hold
+#define MAX_SCENE_DEPTH 64
+
+typedef struct {
+    vec3_t min;
+    vec3_t max;
+} aabb_t;
+
+// inner nodes have two children, leaves a range of mesh_indices
+typedef struct {
+    aabb_t bounds;
+    int parent;
+    int left;
+    int right;
+    int first;
+    int count;
+} bvh_node_t;
+
+static bvh_node_t *nodes = NULL;
+static int *mesh_indices = NULL;
+// world bounds and leaf of every mesh, indexed like the meshes
+static aabb_t *mesh_bounds = NULL;
+static int *mesh_leaves = NULL;
+// meshes whose transform changed since the last refit
+static int *moved_meshes = NULL;
+static mesh_t **visible_meshes = NULL;
+static int num_scene_meshes = -1;
+
+static aabb_t aabb_union(aabb_t a, aabb_t b){
+    aabb_t result = {
+        { fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z) },
+        { fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z) }
+    };
+    return result;
+}
+
+static aabb_t compute_world_bounds(mesh_t *mesh){
+    // transform the box center and grow the extent by the absolute matrix
+    vec3_t center = vec3_mul(vec3_add(mesh->resource->bounds_min, mesh->resource->bounds_max), 0.5);
+    vec3_t extent = vec3_mul(vec3_sub(mesh->resource->bounds_max, mesh->resource->bounds_min), 0.5);
+    mat4_t m = mesh->model_matrix;
+
+    vec3_t world_center = vec3_from_vec4(mat4_mul_vec4(m, vec4_from_vec3(center)));
+    vec3_t world_extent = {
+        fabsf(m.m[0][0]) * extent.x + fabsf(m.m[0][1]) * extent.y + fabsf(m.m[0][2]) * extent.z,
+        fabsf(m.m[1][0]) * extent.x + fabsf(m.m[1][1]) * extent.y + fabsf(m.m[1][2]) * extent.z,
+        fabsf(m.m[2][0]) * extent.x + fabsf(m.m[2][1]) * extent.y + fabsf(m.m[2][2]) * extent.z
+    };
+
+    aabb_t result = { vec3_sub(world_center, world_extent), vec3_add(world_center, world_extent) };
+    return result;
+}
+
+static float aabb_axis_center(aabb_t *box, int axis){
+    return ((&box->min.x)[axis] + (&box->max.x)[axis]) * 0.5;
+}
+
+static int split_axis;
+
+static int compare_mesh_centers(const void *a, const void *b){
+    float center_a = aabb_axis_center(&mesh_bounds[*(const int*)a], split_axis);
+    float center_b = aabb_axis_center(&mesh_bounds[*(const int*)b], split_axis);
+    if (center_a != center_b) return center_a < center_b ? -1 : 1;
+    return *(const int*)a - *(const int*)b;
+}
+
+static int build_node(int parent, int first, int count){
+    bvh_node_t node = { .parent = parent, .left = -1, .right = -1, .first = first, .count = count };
+    node.bounds = mesh_bounds[mesh_indices[first]];
+    for (int i = first + 1; i < first + count; i++){
+        node.bounds = aabb_union(node.bounds, mesh_bounds[mesh_indices[i]]);
+    }
+    array_push(nodes, node);
+    int index = array_size(nodes) - 1;
+
+    if (count <= SCENE_LEAF_SIZE){
+        for (int i = first; i < first + count; i++){
+            mesh_leaves[mesh_indices[i]] = index;
+        }
+        return index;
+    }
+
+    // split at the median along the longest axis of the centers
+    vec3_t size = vec3_sub(node.bounds.max, node.bounds.min);
+    split_axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    qsort(&mesh_indices[first], count, sizeof(int), compare_mesh_centers);
+
+    int half = count / 2;
+    int left = build_node(index, first, half);
+    int right = build_node(index, first + half, count - half);
+    // the array may have moved while the children were pushed
+    nodes[index].left = left;
+    nodes[index].right = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+static void build_scene(void){
+    num_scene_meshes = getNumMeshes();
+    const frame_constants_t *frame = getFrameConstants();
+
+    array_clear(nodes);
+    array_clear(mesh_indices);
+    array_clear(mesh_bounds);
+    array_clear(mesh_leaves);
+    array_clear(moved_meshes);
+    if (num_scene_meshes == 0) return;
+
+    mesh_indices = array_hold(mesh_indices, num_scene_meshes, sizeof(int));
+    mesh_bounds = array_hold(mesh_bounds, num_scene_meshes, sizeof(aabb_t));
+    mesh_leaves = array_hold(mesh_leaves, num_scene_meshes, sizeof(int));
+    for (int i = 0; i < num_scene_meshes; i++){
+        mesh_t *mesh = getMesh(i);
+        update_mesh_matrices(mesh, frame);
+        mesh_indices[i] = i;
+        mesh_bounds[i] = compute_world_bounds(mesh);
+    }
+
+    build_node(-1, 0, num_scene_meshes);
+}
+
+void set_mesh_transform(int mesh_index, vec3_t scale, vec3_t rotation, vec3_t translation){
+    mesh_t *mesh = getMesh(mesh_index);
+    if (mesh == NULL) return;
+
+    mesh->scale = scale;
+    mesh->rotation = rotation;
+    mesh->translation = translation;
+    mark_mesh_moved(mesh_index);
+}
+
+void mark_mesh_moved(int mesh_index){
+    array_push(moved_meshes, mesh_index);
+}
+
+static void refit_scene(void){
+    const frame_constants_t *frame = getFrameConstants();
+
+    for (int i = 0; i < array_size(moved_meshes); i++){
+        int mesh_index = moved_meshes[i];
+        mesh_t *mesh = getMesh(mesh_index);
+        update_mesh_matrices(mesh, frame);
+        mesh_bounds[mesh_index] = compute_world_bounds(mesh);
+
+        // grow or shrink the leaf, then walk up until a node no longer changes
+        for (int node_index = mesh_leaves[mesh_index]; node_index >= 0; node_index = nodes[node_index].parent){
+            bvh_node_t *node = &nodes[node_index];
+            aabb_t bounds;
+            if (node->count > 0){
+                bounds = mesh_bounds[mesh_indices[node->first]];
+                for (int j = node->first + 1; j < node->first + node->count; j++){
+                    bounds = aabb_union(bounds, mesh_bounds[mesh_indices[j]]);
+                }
+            }
+            else {
+                bounds = aabb_union(nodes[node->left].bounds, nodes[node->right].bounds);
+            }
+
+            if (memcmp(&bounds, &node->bounds, sizeof(aabb_t)) == 0) break;
+            node->bounds = bounds;
+        }
+    }
+    array_clear(moved_meshes);
+}
+
+void update_scene(void){
+    // meshes were added since the tree was built
+    if (num_scene_meshes != getNumMeshes()){
+        build_scene();
+        return;
+    }
+    refit_scene();
+}
+
+static int classify_aabb(aabb_t *box, const vec4_t *planes){
+    int result = FRUSTUM_INSIDE;
+    for (int plane = 0; plane < 6; plane++){
+        vec4_t p = planes[plane];
+        // corners farthest along and against the plane normal
+        vec4_t far_corner = { p.x >= 0 ? box->max.x : box->min.x, p.y >= 0 ? box->max.y : box->min.y, p.z >= 0 ? box->max.z : box->min.z, 1 };
+        vec4_t near_corner = { p.x >= 0 ? box->min.x : box->max.x, p.y >= 0 ? box->min.y : box->max.y, p.z >= 0 ? box->min.z : box->max.z, 1 };
+        if (vec4_dot(far_corner, p) < 0) return FRUSTUM_OUTSIDE;
+        if (vec4_dot(near_corner, p) < 0) result = FRUSTUM_INTERSECT;
+    }
+    return result;
+}
+
+static int compare_mesh_instances(const void *a, const void *b){
+    mesh_t *mesh_a = *(mesh_t* const*)a;
+    mesh_t *mesh_b = *(mesh_t* const*)b;
+    if (mesh_a->resource->id != mesh_b->resource->id) return mesh_a->resource->id - mesh_b->resource->id;
+    return (mesh_a > mesh_b) - (mesh_a < mesh_b);
+}
+
+mesh_t **cull_scene(int *num_visible){
+    const frame_constants_t *frame = getFrameConstants();
+    array_clear(visible_meshes);
+
+    int stack[MAX_SCENE_DEPTH];
+    int stack_size = 0;
+    if (array_size(nodes) > 0) stack[stack_size++] = 0;
+
+    while (stack_size > 0){
+        bvh_node_t *node = &nodes[stack[--stack_size]];
+        int result = classify_aabb(&node->bounds, frame->frustum_planes);
+        if (result == FRUSTUM_OUTSIDE) continue;
+
+        // a node inside the frustum takes every mesh below it without further tests
+        if (result == FRUSTUM_INSIDE || node->count > 0){
+            int inner_stack[MAX_SCENE_DEPTH];
+            int inner_size = 0;
+            inner_stack[inner_size++] = node - nodes;
+            while (inner_size > 0){
+                bvh_node_t *inner = &nodes[inner_stack[--inner_size]];
+                if (inner->count == 0){
+                    inner_stack[inner_size++] = inner->right;
+                    inner_stack[inner_size++] = inner->left;
+                    continue;
+                }
+                for (int i = inner->first; i < inner->first + inner->count; i++){
+                    mesh_t *mesh = getMesh(mesh_indices[i]);
+                    update_mesh_matrices(mesh, frame);
+                    mesh->frustum_result = result == FRUSTUM_INSIDE ? FRUSTUM_INSIDE : classify_mesh(mesh);
+                    if (mesh->frustum_result != FRUSTUM_OUTSIDE) array_push(visible_meshes, mesh);
+                }
+            }
+            continue;
+        }
+
+        stack[stack_size++] = node->right;
+        stack[stack_size++] = node->left;
+    }
+
+    // batch the instances of every resource so its shared data stays cached while they are processed,
+    // in load order so the render queue does not depend on the tree shape
+    *num_visible = array_size(visible_meshes);
+    if (*num_visible > 1) qsort(visible_meshes, *num_visible, sizeof(mesh_t*), compare_mesh_instances);
+    return visible_meshes;
+}
+
+void free_scene(void){
+    array_free(nodes);
+    array_free(mesh_indices);
+    array_free(mesh_bounds);
+    array_free(mesh_leaves);
+    array_free(moved_meshes);
+    array_free(visible_meshes);
+    nodes = NULL;
+    mesh_indices = NULL;
+    mesh_bounds = NULL;
+    mesh_leaves = NULL;
+    moved_meshes = NULL;
+    visible_meshes = NULL;
+    num_scene_meshes = -1;
+}
@@ -0,0 +1,19 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "vector.h"
+#include "mesh.h"
+
+// most meshes kept in one leaf of the bounding volume hierarchy
+#define SCENE_LEAF_SIZE 4
+
+// move a mesh through the scene so the hierarchy is refit, bounds of meshes changed directly go stale
+void set_mesh_transform(int mesh_index, vec3_t scale, vec3_t rotation, vec3_t translation);
+// queue a refit for a mesh whose model matrix was changed some other way
+void mark_mesh_moved(int mesh_index);
+
+void update_scene(void);
+mesh_t **cull_scene(int *num_visible);
+void free_scene(void);
+
+#endif //SCENE_H
@@ -1,6 +1,27 @@
+#include <stddef.h>
 #include "texture.h"
+#include "array.h"
+
+// texture of every material, NULL for materials without one
+static upng_t **material_textures = NULL;
 
 tex2_t tex2_clone(tex2_t *t){
     tex2_t result = {t->u, t->v};
     return result;
 }
+
+int add_material(upng_t *texture){
+    array_push(material_textures, texture);
+    return array_size(material_textures) - 1;
+}
+
+upng_t *getMaterialTexture(int material){
+    if (material < 0 || material >= array_size(material_textures)) return NULL;
+    return material_textures[material];
+}
+
+void free_materials(void){
+    // the textures themselves belong to the meshes
+    array_free(material_textures);
+    material_textures = NULL;
+}
@@ -1,10 +1,17 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "upng.h"
+
 typedef struct {
     float u, v;
 } tex2_t;
 
 tex2_t tex2_clone(tex2_t *t);
 
+// render packets refer to textures by a 16 bit material index
+int add_material(upng_t *texture);
+upng_t *getMaterialTexture(int material);
+void free_materials(void);
+
 #endif //TEXTURE_H
@@ -0,0 +1,123 @@
+#include <stdbool.h>
+#include <string.h>
+#include "tile.h"
+#include "display.h"
+#include "arena.h"
+#include "job.h"
+
+static int num_tiles_x = 0;
+static int num_tiles_y = 0;
+// triangle indices per tile in submission order, tile i owns bin_indices[bin_offsets[i]] up to bin_indices[bin_offsets[i + 1]]
+static int *bin_offsets = NULL;
+static int *bin_indices = NULL;
+
+// tiles a triangle touches, inclusive
+typedef struct {
+    int min_x, min_y;
+    int max_x, max_y;
+} tile_range_t;
+
+typedef struct {
+    const render_queue_t *queue;
+    tile_function_t function;
+} tile_job_t;
+
+void init_tile_renderer(void){
+    num_tiles_x = (getWindowWidth() + TILE_SIZE - 1) / TILE_SIZE;
+    num_tiles_y = (getWindowHeight() + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+static bool get_tile_range(const render_queue_t *queue, int index, tile_range_t *range){
+    int min_x = queue->x[0][index];
+    int min_y = queue->y[0][index];
+    int max_x = min_x;
+    int max_y = min_y;
+    for (int i = 1; i < 3; i++){
+        if (queue->x[i][index] < min_x) min_x = queue->x[i][index];
+        if (queue->y[i][index] < min_y) min_y = queue->y[i][index];
+        if (queue->x[i][index] > max_x) max_x = queue->x[i][index];
+        if (queue->y[i][index] > max_y) max_y = queue->y[i][index];
+    }
+
+    // lines round to the nearest pixel and vertex markers extend 6 pixels right and down
+    min_x -= 1;
+    min_y -= 1;
+    max_x += 6;
+    max_y += 6;
+
+    // screen coordinates may lie far outside the window
+    if (min_x < 0) min_x = 0;
+    if (min_y < 0) min_y = 0;
+    if (max_x > getWindowWidth() - 1) max_x = getWindowWidth() - 1;
+    if (max_y > getWindowHeight() - 1) max_y = getWindowHeight() - 1;
+    if (!(min_x <= max_x && min_y <= max_y)) return false;
+
+    range->min_x = min_x / TILE_SIZE;
+    range->min_y = min_y / TILE_SIZE;
+    range->max_x = max_x / TILE_SIZE;
+    range->max_y = max_y / TILE_SIZE;
+    return true;
+}
+
+static void render_tile(int tile_index, void *data){
+    tile_job_t *job = (tile_job_t*) data;
+    int *bin = &bin_indices[bin_offsets[tile_index]];
+    int num_binned = bin_offsets[tile_index + 1] - bin_offsets[tile_index];
+    if (num_binned == 0) return;
+
+    // every tile owns its own part of the color and z buffer, so no locking is needed
+    rect_t screen = getScreenRect();
+    rect_t clip;
+    clip.min_x = (tile_index % num_tiles_x) * TILE_SIZE;
+    clip.min_y = (tile_index / num_tiles_x) * TILE_SIZE;
+    clip.max_x = clip.min_x + TILE_SIZE - 1 < screen.max_x ? clip.min_x + TILE_SIZE - 1 : screen.max_x;
+    clip.max_y = clip.min_y + TILE_SIZE - 1 < screen.max_y ? clip.min_y + TILE_SIZE - 1 : screen.max_y;
+
+    for (int i = 0; i < num_binned; i++){
+        job->function(job->queue, bin[i], clip);
+    }
+}
+
+void render_tiles(const render_queue_t *queue){
+    render_tiles_with(queue, render_triangle);
+}
+
+void render_tiles_with(const render_queue_t *queue, tile_function_t function){
+    int num_tiles = num_tiles_x * num_tiles_y;
+    int num_triangles = queue->count;
+
+    // sort-middle: bin every triangle into the tiles it touches, then rasterize tiles in parallel.
+    // the bins are counted first so they pack into the frame arena without growing
+    tile_range_t *ranges = (tile_range_t*) frame_alloc(num_triangles * sizeof(tile_range_t));
+    bin_offsets = (int*) frame_alloc((num_tiles + 1) * sizeof(int));
+    memset(bin_offsets, 0, (num_tiles + 1) * sizeof(int));
+    for (int i = 0; i < num_triangles; i++){
+        tile_range_t *range = &ranges[i];
+        if (!get_tile_range(queue, i, range)){
+            range->min_x = range->min_y = 0;
+            range->max_x = range->max_y = -1;
+        }
+        for (int tile_y = range->min_y; tile_y <= range->max_y; tile_y++){
+            for (int tile_x = range->min_x; tile_x <= range->max_x; tile_x++){
+                bin_offsets[tile_y * num_tiles_x + tile_x + 1]++;
+            }
+        }
+    }
+    for (int i = 0; i < num_tiles; i++){
+        bin_offsets[i + 1] += bin_offsets[i];
+    }
+
+    int *fill = (int*) frame_alloc(num_tiles * sizeof(int));
+    memcpy(fill, bin_offsets, num_tiles * sizeof(int));
+    bin_indices = (int*) frame_alloc(bin_offsets[num_tiles] * sizeof(int));
+    for (int i = 0; i < num_triangles; i++){
+        for (int tile_y = ranges[i].min_y; tile_y <= ranges[i].max_y; tile_y++){
+            for (int tile_x = ranges[i].min_x; tile_x <= ranges[i].max_x; tile_x++){
+                bin_indices[fill[tile_y * num_tiles_x + tile_x]++] = i;
+            }
+        }
+    }
+
+    tile_job_t job = { queue, function };
+    run_jobs(render_tile, &job, num_tiles);
+}
@@ -0,0 +1,16 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include "triangle.h"
+
+// screen tiles are multiples of the raster block so tiled output matches the single threaded path
+#define TILE_SIZE 64
+
+// draws one triangle of the queue clipped to a tile
+typedef void (*tile_function_t)(const render_queue_t *queue, int index, rect_t clip);
+
+void init_tile_renderer(void);
+void render_tiles(const render_queue_t *queue);
+void render_tiles_with(const render_queue_t *queue, tile_function_t function);
+
+#endif //TILE_H
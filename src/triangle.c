@@ -1,6 +1,7 @@
 #include "triangle.h"
 #include "display.h"
 #include "swap.h"
+#include "raster.h"
 
 vec3_t getTriangleNormal(vec4_t vertices[3]){
     vec3_t vector_a = vec3_from_vec4(vertices[0]);
@@ -18,10 +19,72 @@ vec3_t getTriangleNormal(vec4_t vertices[3]){
     return normal;
 }
 
+void render_triangle(const render_queue_t *queue, int index, rect_t clip){
+    int x[3], y[3];
+    float w[3];
+    for (int i = 0; i < 3; i++){
+        x[i] = queue->x[i][index];
+        y[i] = queue->y[i][index];
+        w[i] = 1.0 / queue->inv_w[i][index];
+    }
+
+    // apply different render mode, the scanline rasterizer ignores the clip rectangle
+    if (RenderMode_Fill && RasterMode_Edge){
+        raster_filled_triangle(queue, index, clip);
+    }
+    else if (RenderMode_Fill){
+        draw_filled_triangle(
+            x[0], y[0], 0, w[0],
+            x[1], y[1], 0, w[1],
+            x[2], y[2], 0, w[2],
+            queue->color[index]
+        );
+    }
+    render_triangle_overlay(queue, index, clip);
+    if (RenderMode_Texture && RasterMode_Edge){
+        raster_textured_triangle(queue, index, clip);
+    }
+    else if (RenderMode_Texture){
+        // the scanline rasterizer flips v itself, so undo the flip of the packet
+        float u[3], v[3];
+        for (int i = 0; i < 3; i++){
+            u[i] = (float) queue->u[i][index] / TEXCOORD_SCALE;
+            v[i] = 1.0 - (float) queue->v[i][index] / TEXCOORD_SCALE;
+        }
+        draw_textured_triangle(
+            x[0], y[0], 0, w[0], u[0], v[0],
+            x[1], y[1], 0, w[1], u[1], v[1],
+            x[2], y[2], 0, w[2], u[2], v[2],
+            getMaterialTexture(queue->material[index])
+        );
+    }
+}
+
+void render_triangle_overlay(const render_queue_t *queue, int index, rect_t clip){
+    vec4_t points[3];
+    for (int i = 0; i < 3; i++){
+        points[i] = (vec4_t){ queue->x[i][index], queue->y[i][index], 0, 1 };
+    }
+
+    // wireframe and vertex markers are drawn on top without depth test
+    if (RenderMode_Wireframe){
+        draw_clipped_triangle(points[0], points[1], points[2], 0xFFFFFFFF, clip);
+    }
+    if (RenderMode_Vertex){
+        draw_clipped_rect(points[0].x, points[0].y, 6, 6, 0xFFFFFF00, clip);
+        draw_clipped_rect(points[1].x, points[1].y, 6, 6, 0xFFFFFF00, clip);
+        draw_clipped_rect(points[2].x, points[2].y, 6, 6, 0xFFFFFF00, clip);
+    }
+}
+
 void draw_triangle(vec4_t point_0, vec4_t point_1, vec4_t point_2, uint32_t color){
-    draw_line(point_0.x, point_0.y, point_1.x, point_1.y, color);
-    draw_line(point_1.x, point_1.y, point_2.x, point_2.y, color);
-    draw_line(point_2.x, point_2.y, point_0.x, point_0.y, color);
+    draw_clipped_triangle(point_0, point_1, point_2, color, getScreenRect());
+}
+
+void draw_clipped_triangle(vec4_t point_0, vec4_t point_1, vec4_t point_2, uint32_t color, rect_t clip){
+    draw_clipped_line(point_0.x, point_0.y, point_1.x, point_1.y, color, clip);
+    draw_clipped_line(point_1.x, point_1.y, point_2.x, point_2.y, color, clip);
+    draw_clipped_line(point_2.x, point_2.y, point_0.x, point_0.y, color, clip);
 }
 
 vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p){
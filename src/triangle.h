@@ -4,24 +4,64 @@
 #include "vector.h"
 #include "texture.h"
 #include "upng.h"
+#include "display.h"
 #include <stdint.h>
 
+// one unique combination of position, texture coordinate and normal of a mesh
 typedef struct {
-    int a, b, c;
-    tex2_t a_uv, b_uv, c_uv;
+    vec3_t position;
+    tex2_t uv;
+    vec3_t normal;
+} mesh_vertex_t;
+
+// position quantized to the mesh bounds and texcoord to the texcoord bounds, a third of mesh_vertex_t
+typedef struct {
+    uint16_t position[3];
+    uint16_t uv[2];
+} packed_vertex_t;
+
+typedef struct {
+    // corners index the vertex buffer of the mesh
+    uint32_t a, b, c;
     uint32_t color;
+    // object space plane of the face, dot(normal, p) == plane_offset for its points
+    vec3_t normal;
+    float plane_offset;
 } face_t;
 
+// fractional bits of the fixed point texture coordinates, 4.12 in 16 bits. triangles with coordinates past
+// eight are shifted by whole repeats when they are packed
+#define TEXCOORD_BITS 12
+#define TEXCOORD_SCALE (1 << TEXCOORD_BITS)
+
+// one projected triangle as the clipper writes it, 42 bytes of fields
 typedef struct {
-    vec4_t points[3];
-    tex2_t tex_coords[3];
+    // whole screen pixels, the guard band stays inside 16 bits for windows up to 21000 pixels wide
+    int16_t x[3], y[3];
+    float inv_w[3];
+    // texture coordinates with v flipped, multiplied by 1/w during triangle setup
+    int16_t u[3], v[3];
     uint32_t color;
-    upng_t *texture;
-} triangle_t;
+    uint16_t material;
+} render_packet_t;
+
+// the render queue, every packet field in its own array
+typedef struct {
+    int16_t *x[3], *y[3];
+    float *inv_w[3];
+    int16_t *u[3], *v[3];
+    uint32_t *color;
+    uint16_t *material;
+    int count;
+} render_queue_t;
 
 vec3_t getTriangleNormal(vec4_t vertices[3]);
 
+void render_triangle(const render_queue_t *queue, int index, rect_t clip);
+void render_triangle_overlay(const render_queue_t *queue, int index, rect_t clip);
+
 void draw_triangle(vec4_t point_0, vec4_t point_1, vec4_t point_2, uint32_t color);
+void draw_clipped_triangle(vec4_t point_0, vec4_t point_1, vec4_t point_2, uint32_t color, rect_t clip);
 void draw_filled_triangle(
     int x0, int y0, float z0, float w0,
     int x1, int y1, float z1, float w1,
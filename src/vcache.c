@@ -0,0 +1,164 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vcache.h"
+#include "array.h"
+
+static int face_corner(const face_t *face, int corner){
+    return (int) (corner == 0 ? face->a : (corner == 1 ? face->b : face->c));
+}
+
+float compute_acmr(const face_t *faces, int num_vertices){
+    int num_faces = array_size((void*) faces);
+    if (num_faces == 0) return 0;
+
+    // misses counted when each vertex last entered the cache, it is evicted once more than the
+    // cache size entered after it
+    int *entered = (int*) malloc(num_vertices * sizeof(int));
+    for (int i = 0; i < num_vertices; i++) entered[i] = -(VERTEX_CACHE_SIZE + 1);
+    int misses = 0;
+    for (int i = 0; i < num_faces; i++){
+        for (int corner = 0; corner < 3; corner++){
+            int vertex = face_corner(&faces[i], corner);
+            if (misses - entered[vertex] > VERTEX_CACHE_SIZE) entered[vertex] = misses++;
+        }
+    }
+    free(entered);
+    return (float) misses / num_faces;
+}
+
+// next fanning vertex: the candidate that stays cached after its remaining faces are emitted and
+// entered the cache earliest, else the latest vertex with faces left, else the next one in order
+static int next_vertex(const int *candidates, const int *live, const int *cache_time, int time, int **dead_end, int *cursor, int num_vertices){
+    int best = -1;
+    int best_priority = 0;
+    for (int i = 0; i < array_size((void*) candidates); i++){
+        int vertex = candidates[i];
+        if (live[vertex] <= 0) continue;
+        int priority = 0;
+        // every remaining face adds at most two vertices to the cache
+        if (time - cache_time[vertex] + 2 * live[vertex] <= VERTEX_CACHE_SIZE) priority = time - cache_time[vertex];
+        if (priority > best_priority){
+            best_priority = priority;
+            best = vertex;
+        }
+    }
+    if (best >= 0) return best;
+
+    while (array_size(*dead_end) > 0){
+        int vertex = (*dead_end)[array_size(*dead_end) - 1];
+        array_truncate(*dead_end, array_size(*dead_end) - 1);
+        if (live[vertex] > 0) return vertex;
+    }
+    while (*cursor < num_vertices){
+        if (live[*cursor] > 0) return *cursor;
+        (*cursor)++;
+    }
+    return -1;
+}
+
+void optimize_vertex_cache(face_t *faces, int num_vertices){
+    // tipsify: emit every face around one vertex at a time, moving on to a vertex that is still cached
+    int num_faces = array_size(faces);
+    if (num_faces == 0) return;
+
+    // faces around every vertex, packed by vertex
+    int *vertex_offsets = (int*) calloc(num_vertices + 1, sizeof(int));
+    int *vertex_faces = (int*) malloc(3 * num_faces * sizeof(int));
+    int *live = (int*) malloc(num_vertices * sizeof(int));
+    for (int i = 0; i < num_faces; i++){
+        for (int corner = 0; corner < 3; corner++) vertex_offsets[face_corner(&faces[i], corner) + 1]++;
+    }
+    for (int i = 0; i < num_vertices; i++){
+        vertex_offsets[i + 1] += vertex_offsets[i];
+        live[i] = vertex_offsets[i];
+    }
+    for (int i = 0; i < num_faces; i++){
+        for (int corner = 0; corner < 3; corner++) vertex_faces[live[face_corner(&faces[i], corner)]++] = i;
+    }
+    // faces not yet emitted around every vertex
+    for (int i = 0; i < num_vertices; i++) live[i] = vertex_offsets[i + 1] - vertex_offsets[i];
+
+    int *cache_time = (int*) calloc(num_vertices, sizeof(int));
+    bool *emitted = (bool*) calloc(num_faces, sizeof(bool));
+    face_t *ordered = (face_t*) malloc(num_faces * sizeof(face_t));
+    int *dead_end = NULL;
+    int *candidates = NULL;
+
+    int num_ordered = 0;
+    int time = VERTEX_CACHE_SIZE + 1;
+    int cursor = 0;
+    int vertex = face_corner(&faces[0], 0);
+    while (vertex >= 0){
+        array_clear(candidates);
+        for (int k = vertex_offsets[vertex]; k < vertex_offsets[vertex + 1]; k++){
+            int face = vertex_faces[k];
+            if (emitted[face]) continue;
+            for (int corner = 0; corner < 3; corner++){
+                int v = face_corner(&faces[face], corner);
+                array_push(dead_end, v);
+                array_push(candidates, v);
+                live[v]--;
+                if (time - cache_time[v] > VERTEX_CACHE_SIZE) cache_time[v] = time++;
+            }
+            emitted[face] = true;
+            ordered[num_ordered++] = faces[face];
+        }
+        vertex = next_vertex(candidates, live, cache_time, time, &dead_end, &cursor, num_vertices);
+    }
+
+    memcpy(faces, ordered, num_faces * sizeof(face_t));
+
+    array_free(candidates);
+    array_free(dead_end);
+    free(ordered);
+    free(emitted);
+    free(cache_time);
+    free(live);
+    free(vertex_faces);
+    free(vertex_offsets);
+}
+
+void optimize_vertex_fetch(mesh_resource_t *resource){
+    int num_vertices = array_size(resource->vertices);
+    if (num_vertices <= 0) return;
+
+    // new index of every vertex in order of first use, the full level comes first and uses the most
+    int *remap = (int*) malloc(num_vertices * sizeof(int));
+    for (int i = 0; i < num_vertices; i++) remap[i] = -1;
+    int next = 0;
+    for (int lod = 0; lod < resource->num_lods; lod++){
+        face_t *faces = resource->lod_faces[lod];
+        for (int i = 0; i < array_size(faces); i++){
+            for (int corner = 0; corner < 3; corner++){
+                int vertex = face_corner(&faces[i], corner);
+                if (remap[vertex] < 0) remap[vertex] = next++;
+            }
+        }
+    }
+    // vertices no face uses go last
+    for (int i = 0; i < num_vertices; i++){
+        if (remap[i] < 0) remap[i] = next++;
+    }
+
+    mesh_vertex_t *vertices = (mesh_vertex_t*) malloc(num_vertices * sizeof(mesh_vertex_t));
+    memcpy(vertices, resource->vertices, num_vertices * sizeof(mesh_vertex_t));
+    for (int i = 0; i < num_vertices; i++){
+        resource->vertices[remap[i]] = vertices[i];
+    }
+    free(vertices);
+
+    for (int lod = 0; lod < resource->num_lods; lod++){
+        face_t *faces = resource->lod_faces[lod];
+        for (int i = 0; i < array_size(faces); i++){
+            faces[i].a = remap[faces[i].a];
+            faces[i].b = remap[faces[i].b];
+            faces[i].c = remap[faces[i].c];
+        }
+        int *meshlet_vertices = resource->lod_meshlets[lod].vertices;
+        for (int i = 0; i < array_size(meshlet_vertices); i++){
+            meshlet_vertices[i] = remap[meshlet_vertices[i]];
+        }
+    }
+    free(remap);
+}
@@ -0,0 +1,16 @@
+#ifndef VCACHE_H
+#define VCACHE_H
+
+#include "mesh.h"
+
+// entries of the fifo vertex cache the face order is tuned for and measured against
+#define VERTEX_CACHE_SIZE 16
+
+// average number of cache misses per face, 3 is the worst and 0.5 the best a closed mesh can get
+float compute_acmr(const face_t *faces, int num_vertices);
+// reorders faces so consecutive ones reuse recently used vertices
+void optimize_vertex_cache(face_t *faces, int num_vertices);
+// renumbers the vertex buffer in the order the faces first use it
+void optimize_vertex_fetch(mesh_resource_t *resource);
+
+#endif //VCACHE_H
@@ -162,4 +162,8 @@ vec3_t vec3_from_vec4(vec4_t v){
 vec2_t vec2_from_vec4(vec4_t v){
     vec2_t result = {v.x, v.y};
     return result;
+}
+
+float vec4_dot(vec4_t a, vec4_t b){
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
 }
\ No newline at end of file
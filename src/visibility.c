@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include "visibility.h"
+#include "display.h"
+#include "raster.h"
+#include "arena.h"
+#include "tile.h"
+#include "job.h"
+
+// triangles set up per job, and rows resolved per job
+#define SETUP_BATCH_SIZE 256
+#define RESOLVE_BAND_HEIGHT 32
+
+typedef struct {
+    triangle_setup_t setup;
+    raster_texture_t texture;
+    bool is_visible;
+} visibility_triangle_t;
+
+// one entry per triangle of the render queue, indexed by triangle id
+static visibility_triangle_t *visibility_triangles = NULL;
+
+typedef struct {
+    const render_queue_t *queue;
+} visibility_job_t;
+
+static void setup_visibility_triangles(int job_index, void *data){
+    visibility_job_t *job = (visibility_job_t*) data;
+    int start = job_index * SETUP_BATCH_SIZE;
+    int end = start + SETUP_BATCH_SIZE < job->queue->count ? start + SETUP_BATCH_SIZE : job->queue->count;
+
+    for (int i = start; i < end; i++){
+        visibility_triangle_t *visibility_triangle = &visibility_triangles[i];
+
+        // without fill, triangles missing a texture are not drawn at all
+        upng_t *texture = RenderMode_Fill ? NULL : getMaterialTexture(job->queue->material[i]);
+        bool is_textured = texture != NULL;
+        if (!RenderMode_Fill && !is_textured){
+            visibility_triangle->is_visible = false;
+            continue;
+        }
+
+        visibility_triangle->is_visible = setup_queue_triangle(
+            &visibility_triangle->setup, job->queue, i, is_textured, getScreenRect()
+        );
+        if (visibility_triangle->is_visible && is_textured){
+            raster_texture_from_upng(&visibility_triangle->texture, texture);
+        }
+    }
+}
+
+static void raster_visibility_triangle(const render_queue_t *queue, int index, rect_t clip){
+    visibility_triangle_t *visibility_triangle = &visibility_triangles[index];
+    if (!visibility_triangle->is_visible) return;
+
+    triangle_setup_t setup = visibility_triangle->setup;
+    if (!clip_triangle_setup(&setup, clip)) return;
+
+    // first pass only writes depth and the triangle id
+    raster_triangle_id(&setup, index, getIdBuffer());
+}
+
+static void resolve_visibility_band(int job_index, void *data){
+    visibility_job_t *job = (visibility_job_t*) data;
+    uint32_t *color_buffer = getColorBuffer();
+    uint32_t *id_buffer = getIdBuffer();
+    int window_width = getWindowWidth();
+
+    int start_y = job_index * RESOLVE_BAND_HEIGHT;
+    int end_y = start_y + RESOLVE_BAND_HEIGHT < getWindowHeight() ? start_y + RESOLVE_BAND_HEIGHT : getWindowHeight();
+
+    // second pass shades every visible pixel exactly once
+    for (int y = start_y; y < end_y; y++){
+        for (int x = 0; x < window_width; x++){
+            int index = y * window_width + x;
+            uint32_t id = id_buffer[index];
+            if (id == VISIBILITY_NONE) continue;
+
+            if (RenderMode_Fill){
+                color_buffer[index] = job->queue->color[id];
+                continue;
+            }
+
+            triangle_setup_t *setup = &visibility_triangles[id].setup;
+            raster_texture_t *texture = &visibility_triangles[id].texture;
+
+            // perspective correct texture coordinates straight from the attribute planes
+            int dx = x - setup->x0;
+            int dy = y - setup->y0;
+            float inv_w = setup->inv_w.origin + setup->inv_w.dx * dx + setup->inv_w.dy * dy;
+            float u = (setup->u_over_w.origin + setup->u_over_w.dx * dx + setup->u_over_w.dy * dy) / inv_w;
+            float v = (setup->v_over_w.origin + setup->v_over_w.dx * dx + setup->v_over_w.dy * dy) / inv_w;
+
+            int texel_x = abs((int)(u * texture->width)) % texture->width;
+            int texel_y = abs((int)(v * texture->height)) % texture->height;
+            color_buffer[index] = texture->buffer[texel_y * texture->width + texel_x];
+        }
+    }
+}
+
+void render_visibility(const render_queue_t *queue){
+    visibility_job_t job = { queue };
+    int num_triangles = queue->count;
+
+    if (RenderMode_Fill || RenderMode_Texture){
+        // one entry per triangle, valid for the rest of the frame
+        visibility_triangles = (visibility_triangle_t*) frame_alloc(num_triangles * sizeof(visibility_triangle_t));
+        run_jobs(setup_visibility_triangles, &job, (num_triangles + SETUP_BATCH_SIZE - 1) / SETUP_BATCH_SIZE);
+
+        clear_id_buffer();
+        if (RasterMode_Tiled){
+            render_tiles_with(queue, raster_visibility_triangle);
+        }
+        else {
+            for (int i = 0; i < num_triangles; i++){
+                raster_visibility_triangle(queue, i, getScreenRect());
+            }
+        }
+
+        run_jobs(resolve_visibility_band, &job, (getWindowHeight() + RESOLVE_BAND_HEIGHT - 1) / RESOLVE_BAND_HEIGHT);
+    }
+
+    if (RenderMode_Wireframe || RenderMode_Vertex){
+        if (RasterMode_Tiled){
+            render_tiles_with(queue, render_triangle_overlay);
+        }
+        else {
+            for (int i = 0; i < num_triangles; i++){
+                render_triangle_overlay(queue, i, getScreenRect());
+            }
+        }
+    }
+}
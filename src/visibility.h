@@ -0,0 +1,12 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <stdint.h>
+#include "triangle.h"
+
+// id buffer value of pixels no triangle covers
+#define VISIBILITY_NONE 0xFFFFFFFF
+
+void render_visibility(const render_queue_t *queue);
+
+#endif //VISIBILITY_H